@@ -12,27 +12,55 @@
 #include <string>
 
 #include "src/API/api.hpp"
-#include "src/API/sand_box_api.hpp"
+#include "src/API/db_executor.hpp"
+#include "src/API/sandbox_pool.hpp"
+#include "src/API/judge_queue.hpp"
+#include "src/API/permission_index.hpp"
+#include "src/API/rejudger.hpp"
+#include "src/API/test_case_cache.hpp"
+#include "src/API/verdict_hub.hpp"
+#include "src/API/verdict_cache.hpp"
 
+#include "src/CROW_ROUTEs/auth_middleware.hpp"
 #include "src/CROW_ROUTEs/register.hpp"
 #include "src/CROW_ROUTEs/login.hpp"
 #include "src/CROW_ROUTEs/problems.hpp"
 #include "src/CROW_ROUTEs/problem.hpp"
 #include "src/CROW_ROUTEs/manage_panel.hpp"
 #include "src/CROW_ROUTEs/submit.hpp"
+#include "src/CROW_ROUTEs/submission_stream.hpp"
 
 #include "src/Programs/get_ip.hpp"
+#include "src/Programs/password_hasher.hpp"
+#include "src/Programs/problem_counters.hpp"
+#include "src/Programs/token_cache.hpp"
 
 #include "src/include/lrucache.hpp"
 
 /** Configuration settings for the application. */
 nlohmann::json settings;
-/** Pointer to the APIs class. */
-std::unique_ptr<APIs> api, modify_api, submission_api;
-/** Pointer to the SandBoxAPI class. */
-std::unique_ptr<sand_box_api> sandbox_api;
+/** Pointer to the APIs class, shared by every route through its connection pool. */
+std::unique_ptr<APIs> api;
+/** Pointer to the DBExecutor that runs database-bound handlers off the Crow worker threads. */
+std::unique_ptr<DBExecutor> db_executor;
+/** Pointer to the PasswordHasher that runs bcrypt off the Crow worker threads; destroyed before db_executor. */
+std::unique_ptr<PasswordHasher> password_hasher;
+/** Pointer to the SandboxPool that spreads judge jobs over the sandbox nodes. */
+std::unique_ptr<SandboxPool> sandbox_pool;
+/** Cached test cases per problem for the judge workers, invalidated by the manage panel. */
+TestCaseCache test_case_cache;
+/** Verdicts of judged source code, so identical resubmissions skip the sandbox. */
+std::unique_ptr<VerdictCache> verdict_cache;
+/** Fans the progress of the submissions out from the judge workers to websocket clients. */
+VerdictHub verdict_hub;
+/** Pointer to the JudgeQueue that judges submissions in the background. */
+std::unique_ptr<JudgeQueue> judge_queue;
+/** Pointer to the Rejudger that rejudges problems in the background; destroyed before judge_queue. */
+std::unique_ptr<Rejudger> rejudger;
+/** Claims of the JWTs already verified, shared by every request. */
+std::unique_ptr<TokenCache> token_cache;
 /** The CROW application object. */
-crow::App<crow::CORSHandler> app;
+CrowApp app;
 /** The IP address of the BE. */
 std::string IP;
 /** Cache hit flag for problems_everyone_cache. */
@@ -40,8 +68,12 @@ std::atomic<bool> problems_everyone_cache_hit{false};
 
 /** Cache for problems available to everyone */
 cache::lru_cache<int8_t, nlohmann::json> problems_everyone_cache(100);
+/** The grants of problem_role by problem, reloaded by the manage panel. */
+PermissionIndex permission_index;
+/** Cached problem counts per role set, invalidated by the manage panel. */
+ProblemCounters problem_counters;
 /** Cache for specific problem data */
-cache::lru_cache<int16_t, nlohmann::json> problem_cache(1000);
+cache::lru_cache<int, nlohmann::json> problem_cache(1000);
 
 std::vector<std::string> accepted_languages;
 
@@ -87,31 +119,199 @@ nlohmann::json loadSettings(const std::string& defaultSettingsFileName, const st
 }
 
 
+/**
+ * @brief Builds the connection pool configuration of one MySQL endpoint.
+ * 
+ * Keys missing from the endpoint (user, password, database, port, pool) are taken from the primary
+ * "MySQL" block, so a replica entry can be as short as {"host": "..."}.
+ * 
+ * @param endpoint The JSON object of the endpoint.
+ * @param primary The JSON object of the primary endpoint.
+ * @return The connection pool configuration.
+ */
+ConnectionPool::Config sqlPoolConfig(const nlohmann::json& endpoint, const nlohmann::json& primary) {
+    ConnectionPool::Config config;
+    config.host = endpoint.value("host", primary["host"].get<std::string>());
+    config.user = endpoint.value("user", primary["user"].get<std::string>());
+    config.password = endpoint.value("password", primary["password"].get<std::string>());
+    config.database = endpoint.value("database", primary["database"].get<std::string>());
+    config.port = endpoint.value("port", primary["port"].get<int>());
+    const nlohmann::json& pool = endpoint.contains("pool") ? endpoint["pool"] : primary.value("pool", nlohmann::json::object());
+    config.min_size = pool.value("min_size", config.min_size);
+    config.max_size = pool.value("max_size", config.max_size);
+    config.idle_timeout = std::chrono::seconds(pool.value("idle_timeout_seconds", config.idle_timeout.count()));
+    config.wait_timeout = std::chrono::milliseconds(pool.value("wait_timeout_ms", config.wait_timeout.count()));
+    config.validation_interval = std::chrono::seconds(pool.value("validation_interval_seconds", config.validation_interval.count()));
+    config.statement_cache_size = pool.value("statement_cache_size", config.statement_cache_size);
+    return config;
+}
+
 /**
  * @brief Creates and initializes an instance of APIs based on the provided settings.
  * 
  * This function takes a JSON object containing settings for MySQL database connection and creates an instance of APIs class.
  * The settings should include the host, user, password, database, and port information for the MySQL connection.
+ * The optional "pool" object sizes the connection pool, "replicas" lists read replicas and
+ * "read_your_writes_seconds" is how long a user's reads stay on the primary after a write and
+ * "slow_query_ms" is the threshold of the slow-query log (0 disables it).
  * 
  * @param settings The JSON object containing the MySQL connection settings.
  * @return A unique pointer to the created APIs instance.
  */
 auto setupSqlAPI(const nlohmann::json& settings) {
-    return std::make_unique<APIs>(
-        settings["MySQL"]["host"].get<std::string>(),
-        settings["MySQL"]["user"].get<std::string>(),
-        settings["MySQL"]["password"].get<std::string>(),
-        settings["MySQL"]["database"].get<std::string>(),
-        settings["MySQL"]["port"].get<int>()
+    const nlohmann::json& mysql = settings["MySQL"];
+    std::vector<ConnectionPool::Config> replicas;
+    for (const auto& replica : mysql.value("replicas", nlohmann::json::array())) {
+        replicas.push_back(sqlPoolConfig(replica, mysql));
+    }
+    auto api = std::make_unique<APIs>(
+        sqlPoolConfig(mysql, mysql),
+        replicas,
+        std::chrono::seconds(mysql.value("read_your_writes_seconds", 5))
     );
+    api->queryStats().setSlowThreshold(std::chrono::milliseconds(mysql.value("slow_query_ms", 200)));
+    return api;
+}
+
+/**
+ * @brief Creates the database executor based on the provided settings.
+ * 
+ * Reads the optional "executor" object of the "MySQL" block: "threads" is the number of database
+ * threads and "max_queue" the number of jobs that may wait for one before requests are shed with 503.
+ * 
+ * @param settings The JSON object containing the MySQL settings.
+ * @return A unique pointer to the created DBExecutor instance.
+ */
+auto setupDBExecutor(const nlohmann::json& settings) {
+    nlohmann::json executor = settings["MySQL"].value("executor", nlohmann::json::object());
+    return std::make_unique<DBExecutor>(
+        executor.value("threads", 8),
+        executor.value("max_queue", 256)
+    );
+}
+
+/**
+ * @brief Creates the password hashing pool based on the provided settings.
+ *
+ * Reads the optional "PasswordHashing" object: "threads" hashing threads, "max_queue" jobs that
+ * may wait for one before /login and /register are shed with 503, and "bcrypt_cost" the work
+ * factor of new hashes.
+ *
+ * @param settings The JSON object containing the settings.
+ * @return A unique pointer to the created PasswordHasher instance.
+ */
+auto setupPasswordHasher(const nlohmann::json& settings) {
+    nlohmann::json hashing = settings.value("PasswordHashing", nlohmann::json::object());
+    PasswordHasher::Config config;
+    config.threads = hashing.value("threads", config.threads);
+    config.max_queue = hashing.value("max_queue", config.max_queue);
+    config.cost = hashing.value("bcrypt_cost", config.cost);
+    return std::make_unique<PasswordHasher>(config);
+}
+
+/**
+ * @brief Creates the sandbox node pool based on the provided settings.
+ * 
+ * The "SandBox" object either describes a single node with "host", "port" and "token", or lists
+ * several in "nodes"; keys missing from a node ("port", "token", "weight", "capacity",
+ * "max_connections") are taken from the "SandBox" object itself. It may also set the per-job
+ * defaults "timeout_ms", "connect_timeout_ms", "retries", "retry_backoff_ms" and
+ * "compress_min_bytes" (bodies at least this large are sent gzip-compressed), and the health
+ * checking "probe_interval_ms", "probe_timeout_ms", "eject_after_failures", "eject_ms" and
+ * "slow_start_ms".
+ * 
+ * @param settings The JSON object containing the settings.
+ * @return A unique pointer to the created SandboxPool instance.
+ */
+auto setupSandboxPool(const nlohmann::json& settings) {
+    const nlohmann::json& sandbox = settings["SandBox"];
+    SandboxPool::Config config;
+    config.request.timeout = std::chrono::milliseconds(sandbox.value("timeout_ms", config.request.timeout.count()));
+    config.request.connect_timeout = std::chrono::milliseconds(sandbox.value("connect_timeout_ms", config.request.connect_timeout.count()));
+    config.request.retries = sandbox.value("retries", config.request.retries);
+    config.request.retry_backoff = std::chrono::milliseconds(sandbox.value("retry_backoff_ms", config.request.retry_backoff.count()));
+    config.request.compress_min_bytes = sandbox.value("compress_min_bytes", config.request.compress_min_bytes);
+    config.probe_interval = std::chrono::milliseconds(sandbox.value("probe_interval_ms", config.probe_interval.count()));
+    config.probe_timeout = std::chrono::milliseconds(sandbox.value("probe_timeout_ms", config.probe_timeout.count()));
+    config.eject_after_failures = sandbox.value("eject_after_failures", config.eject_after_failures);
+    config.eject_time = std::chrono::milliseconds(sandbox.value("eject_ms", config.eject_time.count()));
+    config.slow_start = std::chrono::milliseconds(sandbox.value("slow_start_ms", config.slow_start.count()));
+
+    nlohmann::json nodeList = sandbox.value("nodes", nlohmann::json::array({sandbox}));
+    std::vector<SandboxPool::NodeConfig> nodes;
+    for (const auto& entry : nodeList) {
+        SandboxPool::NodeConfig node;
+        node.host = entry.value("host", sandbox.value("host", std::string()));
+        node.port = entry.value("port", sandbox.value("port", 0));
+        node.token = entry.value("token", sandbox.value("token", std::string()));
+        node.weight = entry.value("weight", sandbox.value("weight", node.weight));
+        node.capacity = entry.value("capacity", sandbox.value("capacity", node.capacity));
+        node.max_connections = entry.value("max_connections", sandbox.value("max_connections", node.max_connections));
+        nodes.push_back(node);
+    }
+    return std::make_unique<SandboxPool>(nodes, config);
 }
 
-auto setupSandboxAPI(const nlohmann::json& settings) {
-    return std::make_unique<sand_box_api>(
-        settings["SandBox"]["host"].get<std::string>(),
-        settings["SandBox"]["port"].get<int>(),
-        settings["SandBox"]["token"].get<std::string>()
+/**
+ * @brief Creates the judge queue based on the provided settings and queues the submissions left Pending.
+ * 
+ * Reads the optional "Judge" object: "workers" is the number of submissions judged at once,
+ * "max_queue" the number of submissions that may wait before /submit answers 503 and
+ * "max_in_flight" the most submissions of each priority class ("contest", "practice", "rejudge")
+ * judged at once, where 0 or a missing class allows every worker. "chunk_threads" is the number of
+ * threads sending the further chunks of chunked problems, shared by all workers (0 or missing uses
+ * one per worker). "test_case_cache_mb" bounds the test cases kept in memory for the workers and
+ * "verdict_cache_entries" the verdicts remembered for identical resubmissions.
+ * 
+ * @param settings The JSON object containing the settings.
+ * @return A unique pointer to the created JudgeQueue instance.
+ */
+auto setupJudgeQueue(const nlohmann::json& settings) {
+    nlohmann::json judge = settings.value("Judge", nlohmann::json::object());
+    nlohmann::json maxInFlight = judge.value("max_in_flight", nlohmann::json::object());
+    std::array<size_t, JudgeQueue::priority_count> classCaps{};
+    for (size_t i = 0; i < JudgeQueue::priority_count; i++) {
+        classCaps[i] = maxInFlight.value(JudgeQueue::priorityName(static_cast<JudgeQueue::Priority>(i)), 0);
+    }
+    test_case_cache.setMaxBytes(judge.value("test_case_cache_mb", size_t(256)) << 20);
+    verdict_cache = std::make_unique<VerdictCache>(judge.value("verdict_cache_entries", size_t(65536)));
+    auto queue = std::make_unique<JudgeQueue>(
+        *api,
+        *sandbox_pool,
+        test_case_cache,
+        verdict_hub,
+        *verdict_cache,
+        judge.value("workers", 4),
+        judge.value("max_queue", 1024),
+        classCaps,
+        judge.value("chunk_threads", size_t(0))
     );
+    size_t recovered = queue->recoverPending();
+    if (recovered > 0) {
+        std::cerr << "Requeued " << recovered << " pending submissions" << std::endl;
+    }
+    return queue;
+}
+
+/**
+ * @brief Creates the rejudger based on the provided settings.
+ * 
+ * Reads the optional "Judge"."rejudge" object: "chunk_size" submissions are read per query, at
+ * most "rate_per_second" are queued per second and "max_outstanding" at once, and their verdicts
+ * are written "batch_size" at a time, waiting at most "flush_interval_ms".
+ * 
+ * @param settings The JSON object containing the settings.
+ * @return A unique pointer to the created Rejudger instance.
+ */
+auto setupRejudger(const nlohmann::json& settings) {
+    nlohmann::json rejudge = settings.value("Judge", nlohmann::json::object()).value("rejudge", nlohmann::json::object());
+    Rejudger::Config config;
+    config.chunk_size = rejudge.value("chunk_size", config.chunk_size);
+    config.rate_per_second = rejudge.value("rate_per_second", config.rate_per_second);
+    config.max_outstanding = rejudge.value("max_outstanding", config.max_outstanding);
+    config.batch_size = rejudge.value("batch_size", config.batch_size);
+    config.flush_interval = std::chrono::milliseconds(rejudge.value("flush_interval_ms", config.flush_interval.count()));
+    return std::make_unique<Rejudger>(*api, *judge_queue, config);
 }
 
 // void setupSSL(crow::ssl_context_t& ctx) {
@@ -140,9 +340,18 @@ void setupCORS() {
             .origin(settings["CGFE_origin"].get<std::string>());
 }
 
+/**
+ * @brief Sets up the middleware that verifies and decodes the JWT of every request once.
+ * "token_cache_entries" bounds the verified tokens remembered across requests.
+ */
+void setupAuth() {
+    token_cache = std::make_unique<TokenCache>(settings.value("token_cache_entries", size_t(65536)));
+    app.get_middleware<AuthMiddleware>().configure(settings, IP, *token_cache);
+}
+
 void setupAcceptedLanguages() {
     std::string query = "SELECT COLUMN_TYPE FROM INFORMATION_SCHEMA.COLUMNS WHERE TABLE_NAME = 'problem_submissions' AND COLUMN_NAME = 'language';";
-    std::unique_ptr<sql::PreparedStatement> pstmt(api->prepareStatement(query));
+    std::unique_ptr<PooledStatement> pstmt(api->prepareStatement(query));
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
     if (res->next()) {
         std::string column_type = res->getString("COLUMN_TYPE");
@@ -164,12 +373,13 @@ void setupAcceptedLanguages() {
  * This function registers various routes for handling different requests.
  */
 void setupRoutes() {
-    ROUTE_problems(app, settings, IP, api, problems_everyone_cache, problems_everyone_cache_hit);
-    ROUTE_problem(app, settings, IP, api, problem_cache);
-    ROUTE_Register(app, settings, IP, api);
-    ROUTE_Login(app, settings, IP, api);
-    ROUTE_manage_panel(app, settings, IP, modify_api, api);
-    ROUTE_Submit(app, settings, IP, api, submission_api, accepted_languages, sandbox_api);
+    ROUTE_problems(app, settings, IP, api, db_executor, problem_counters, problems_everyone_cache, problems_everyone_cache_hit);
+    ROUTE_problem(app, settings, IP, api, db_executor, problem_cache, permission_index);
+    ROUTE_Register(app, settings, IP, api, db_executor, password_hasher);
+    ROUTE_Login(app, settings, IP, api, db_executor, password_hasher);
+    ROUTE_manage_panel(app, settings, IP, api, db_executor, problem_counters, test_case_cache, verdict_hub, judge_queue, rejudger, token_cache, permission_index, password_hasher, problem_cache);
+    ROUTE_Submit(app, settings, IP, api, accepted_languages, judge_queue, permission_index);
+    ROUTE_SubmissionStream(app, settings, IP, verdict_hub);
 }
 
 /**
@@ -184,11 +394,15 @@ int main()
     // crow::ssl_context_t ctx(crow::ssl_context_t::tlsv13);
     // setupSSL(ctx);
     setupCORS();
+    setupAuth();
     setupRoutes();
     api = setupSqlAPI(settings);
-    modify_api = setupSqlAPI(settings);
-    submission_api = setupSqlAPI(settings);
-    sandbox_api = setupSandboxAPI(settings);
+    permission_index.load(*api);
+    db_executor = setupDBExecutor(settings);
+    password_hasher = setupPasswordHasher(settings);
+    sandbox_pool = setupSandboxPool(settings);
+    judge_queue = setupJudgeQueue(settings);
+    rejudger = setupRejudger(settings);
     setupAcceptedLanguages();
 
     app.port(settings["port"].get<int>()).multithreaded().run();// .ssl(std::move(ctx))
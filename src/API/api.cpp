@@ -5,45 +5,426 @@
 
 #include "api.hpp"
 
-APIs::APIs(const std::string& SQL_host, const std::string& SQL_user, const std::string& SQL_password, const std::string& SQL_database, int SQL_port) {
-    driver = sql::mysql::get_mysql_driver_instance();
-    std::string hostWithPort = SQL_host + ":" + std::to_string(SQL_port);
-    con = std::unique_ptr<sql::Connection>(driver->connect(hostWithPort, SQL_user, SQL_password));
-    con->setSchema(SQL_database);
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+namespace {
+/** The innermost read-your-writes scope of the calling thread. */
+thread_local APIs::ReadYourWrites* current_scope = nullptr;
+
+int64_t ticks(std::chrono::steady_clock::time_point time) {
+    return time.time_since_epoch().count();
+}
+
+uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+/**
+ * @brief Marks the connection broken if the exception being handled says the server connection was lost.
+ *
+ * Must be called from a catch block. A broken connection is closed on release instead of going
+ * back to the idle list.
+ */
+void markIfLost(PooledConnection& connection) {
+    try {
+        throw;
+    } catch (const sql::SQLException& e) {
+        // CR_SERVER_GONE_ERROR, CR_SERVER_LOST and CR_SERVER_LOST_EXTENDED
+        if (e.getErrorCode() == 2006 || e.getErrorCode() == 2013 || e.getErrorCode() == 2055) {
+            connection.broken = true;
+        }
+    } catch (...) {
+    }
+}
+}
+
+PooledStatement::PooledStatement(ConnectionPool::Handle connection, std::unique_ptr<sql::PreparedStatement> statement, std::string query, APIs* writer, QueryStats* stats, uint64_t wait_us, uint64_t prepare_us)
+    : connection(std::move(connection)), statement(std::move(statement)), query(std::move(query)), writer(writer), stats(stats), pending_wait_us(wait_us), pending_prepare_us(prepare_us) {}
+
+PooledStatement::~PooledStatement() {
+    if (!connection->broken) {
+        connection->statements.put(query, std::move(statement));
+    }
+}
+
+unsigned int PooledStatement::setStringList(unsigned int firstIndex, const std::vector<std::string>& values) {
+    size_t arity = APIs::inArity(values.size());
+    for (size_t i = 0; i < arity; i++) {
+        statement->setString(firstIndex + i, values[std::min(i, values.size() - 1)]);
+    }
+    return firstIndex + arity;
 }
 
-std::unique_ptr<sql::ResultSet> APIs::read(const std::string& query) {
-    std::lock_guard<std::recursive_mutex> lock(mtx);
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    std::unique_ptr<sql::ResultSet> res(stmt->executeQuery(query));
+void PooledStatement::record(std::chrono::steady_clock::time_point start, int64_t rows, bool failed) {
+    stats->record(query, pending_wait_us, pending_prepare_us + elapsedUs(start), rows, failed);
+    pending_wait_us = 0;
+    pending_prepare_us = 0;
+}
+
+sql::ResultSet* PooledStatement::executeQuery() {
+    auto start = std::chrono::steady_clock::now();
+    sql::ResultSet* res;
+    try {
+        res = statement->executeQuery();
+    } catch (...) {
+        markIfLost(*connection);
+        record(start, -1, true);
+        throw;
+    }
+    record(start, res->rowsCount());
     return res;
 }
 
+bool PooledStatement::execute() {
+    if (writer) {
+        writer->noteWrite();
+    }
+    auto start = std::chrono::steady_clock::now();
+    bool isResultSet;
+    try {
+        isResultSet = statement->execute();
+    } catch (...) {
+        markIfLost(*connection);
+        record(start, -1, true);
+        throw;
+    }
+    record(start, isResultSet ? -1 : statement->getUpdateCount());
+    return isResultSet;
+}
+
+int PooledStatement::executeUpdate() {
+    if (writer) {
+        writer->noteWrite();
+    }
+    auto start = std::chrono::steady_clock::now();
+    int updateCount;
+    try {
+        updateCount = statement->executeUpdate();
+    } catch (...) {
+        markIfLost(*connection);
+        record(start, -1, true);
+        throw;
+    }
+    record(start, updateCount);
+    return updateCount;
+}
+
+APIs::ReadYourWrites::ReadYourWrites(APIs& api, int64_t key) : api(api), key(key), previous(current_scope) {
+    current_scope = this;
+}
+
+APIs::ReadYourWrites::~ReadYourWrites() {
+    current_scope = previous;
+}
+
+APIs::APIs(const ConnectionPool::Config& config, const std::vector<ConnectionPool::Config>& replicaConfigs, std::chrono::seconds readYourWritesWindow)
+    : read_your_writes_window(readYourWritesWindow) {
+    pool = ConnectionPool::create(config);
+    for (const auto& replicaConfig : replicaConfigs) {
+        auto replica = std::make_unique<Replica>();
+        try {
+            replica->pool = ConnectionPool::create(replicaConfig);
+        } catch (const std::exception& e) {
+            // a replica that is down at startup must not keep the backend from starting
+            std::cerr << "Replica " << replicaConfig.host << ":" << replicaConfig.port << " unavailable: " << e.what() << std::endl;
+            ConnectionPool::Config lazy = replicaConfig;
+            lazy.min_size = 0;
+            replica->pool = ConnectionPool::create(lazy);
+            replica->down_until = ticks(std::chrono::steady_clock::now() + replica_cooldown);
+        }
+        replicas.push_back(std::move(replica));
+    }
+}
+
+ConnectionPool::Handle APIs::connection() {
+    {
+        std::lock_guard<std::mutex> lock(transactions_mtx);
+        auto it = transactions.find(std::this_thread::get_id());
+        if (it != transactions.end()) {
+            return it->second;
+        }
+    }
+    return pool->acquire();
+}
+
+ConnectionPool::Handle APIs::readConnection() {
+    {
+        std::lock_guard<std::mutex> lock(transactions_mtx);
+        auto it = transactions.find(std::this_thread::get_id());
+        if (it != transactions.end()) {
+            return it->second;
+        }
+    }
+    if (replicas.empty() || stickyToPrimary()) {
+        return pool->acquire();
+    }
+    for (size_t attempt = 0; attempt < replicas.size(); attempt++) {
+        Replica& replica = *replicas[next_replica++ % replicas.size()];
+        auto now = std::chrono::steady_clock::now();
+        if (ticks(now) < replica.down_until) {
+            continue;
+        }
+        try {
+            // a busy replica is healthy, so only this read moves on instead of waiting for it
+            if (ConnectionPool::Handle con = replica.pool->tryAcquire()) {
+                return con;
+            }
+        } catch (const sql::SQLException& e) {
+            // the replica could not be reached
+            replica.down_until = ticks(now + replica_cooldown);
+        }
+    }
+    return pool->acquire();
+}
+
+bool APIs::stickyToPrimary() {
+    if (!current_scope || &current_scope->api != this) {
+        return false;
+    }
+    if (current_scope->wrote) {
+        return true;
+    }
+    std::lock_guard<std::mutex> lock(recent_writes_mtx);
+    auto it = recent_writes.find(current_scope->key);
+    return it != recent_writes.end() && std::chrono::steady_clock::now() - it->second < read_your_writes_window;
+}
+
+void APIs::noteWrite() {
+    if (!current_scope || &current_scope->api != this) {
+        return;
+    }
+    current_scope->wrote = true;
+    auto now = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(recent_writes_mtx);
+    recent_writes[current_scope->key] = now;
+    if (recent_writes.size() > 4096) {
+        for (auto it = recent_writes.begin(); it != recent_writes.end();) {
+            it = now - it->second >= read_your_writes_window ? recent_writes.erase(it) : std::next(it);
+        }
+    }
+}
+
+PooledResultSet APIs::read(const std::string& query) {
+    auto start = std::chrono::steady_clock::now();
+    ConnectionPool::Handle con = readConnection();
+    uint64_t wait_us = elapsedUs(start);
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<sql::Statement> stmt(con->con->createStatement());
+    std::unique_ptr<sql::ResultSet> res;
+    try {
+        res.reset(stmt->executeQuery(query));
+    } catch (...) {
+        markIfLost(*con);
+        query_stats.record(query, wait_us, elapsedUs(start), -1, true);
+        throw;
+    }
+    query_stats.record(query, wait_us, elapsedUs(start), res->rowsCount());
+    return PooledResultSet(std::move(con), std::move(stmt), std::move(res));
+}
+
 int APIs::write(const std::string& query) {
-    std::lock_guard<std::recursive_mutex> lock(mtx);
-    std::unique_ptr<sql::Statement> stmt(con->createStatement());
-    int updateCount = stmt->executeUpdate(query);
+    noteWrite();
+    auto start = std::chrono::steady_clock::now();
+    ConnectionPool::Handle con = connection();
+    uint64_t wait_us = elapsedUs(start);
+    start = std::chrono::steady_clock::now();
+    std::unique_ptr<sql::Statement> stmt(con->con->createStatement());
+    int updateCount;
+    try {
+        updateCount = stmt->executeUpdate(query);
+    } catch (...) {
+        markIfLost(*con);
+        query_stats.record(query, wait_us, elapsedUs(start), -1, true);
+        throw;
+    }
+    query_stats.record(query, wait_us, elapsedUs(start), updateCount);
     return updateCount;
 }
 
-std::unique_ptr<sql::PreparedStatement> APIs::prepareStatement(const std::string& query) {
-    std::lock_guard<std::recursive_mutex> lock(mtx);
-    return std::unique_ptr<sql::PreparedStatement>(con->prepareStatement(query));
+std::unique_ptr<PooledStatement> APIs::prepareStatement(const std::string& query, Access access) {
+    auto start = std::chrono::steady_clock::now();
+    ConnectionPool::Handle con = access == Access::Read ? readConnection() : connection();
+    uint64_t wait_us = elapsedUs(start);
+    uint64_t prepare_us = 0;
+    std::unique_ptr<sql::PreparedStatement> stmt = con->statements.take(query);
+    if (stmt) {
+        statement_cache_hits++;
+    } else {
+        statement_cache_misses++;
+        start = std::chrono::steady_clock::now();
+        try {
+            stmt.reset(con->con->prepareStatement(query));
+        } catch (...) {
+            markIfLost(*con);
+            query_stats.record(query, wait_us, elapsedUs(start), -1, true);
+            throw;
+        }
+        prepare_us = elapsedUs(start);
+    }
+    return std::make_unique<PooledStatement>(std::move(con), std::move(stmt), query, access == Access::Write ? this : nullptr, &query_stats, wait_us, prepare_us);
 }
 
 void APIs::beginTransaction() {
-    mtx.lock();
-    con->setAutoCommit(false);
+    std::thread::id id = std::this_thread::get_id();
+    {
+        std::lock_guard<std::mutex> lock(transactions_mtx);
+        if (transactions.count(id)) {
+            throw std::runtime_error("A transaction is already open on this thread");
+        }
+    }
+    noteWrite();
+    ConnectionPool::Handle con = pool->acquire();
+    con->con->setAutoCommit(false);
+    con->in_transaction = true;
+    con->transaction_started = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(transactions_mtx);
+    transactions[id] = std::move(con);
 }
 
 void APIs::commitTransaction() {
-    con->commit();
-    con->setAutoCommit(true);
-    mtx.unlock();
+    ConnectionPool::Handle con;
+    {
+        std::lock_guard<std::mutex> lock(transactions_mtx);
+        auto it = transactions.find(std::this_thread::get_id());
+        if (it == transactions.end()) {
+            throw std::runtime_error("No transaction is open on this thread");
+        }
+        con = it->second;
+    }
+    // on failure the transaction stays bound so the caller can still roll it back
+    try {
+        con->con->commit();
+    } catch (...) {
+        markIfLost(*con);
+        throw;
+    }
+    recordTransaction(*con);
+    con->con->setAutoCommit(true);
+    con->in_transaction = false;
+    std::lock_guard<std::mutex> lock(transactions_mtx);
+    transactions.erase(std::this_thread::get_id());
 }
 
 void APIs::rollbackTransaction() {
-    con->rollback();
-    con->setAutoCommit(true);
-    mtx.unlock();
-}
\ No newline at end of file
+    ConnectionPool::Handle con;
+    {
+        std::lock_guard<std::mutex> lock(transactions_mtx);
+        auto it = transactions.find(std::this_thread::get_id());
+        if (it == transactions.end()) {
+            return;
+        }
+        con = std::move(it->second);
+        transactions.erase(it);
+    }
+    recordTransaction(*con);
+    try {
+        con->con->rollback();
+        con->con->setAutoCommit(true);
+        con->in_transaction = false;
+    } catch (const sql::SQLException& e) {
+        con->broken = true;
+    }
+}
+
+void APIs::recordTransaction(const PooledConnection& con) {
+    uint64_t us = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - con.transaction_started).count();
+    transaction_count++;
+    transaction_total_us += us;
+    uint64_t max = transaction_max_us.load();
+    while (us > max && !transaction_max_us.compare_exchange_weak(max, us)) {}
+}
+
+size_t APIs::insertBatch(const std::string& table, const std::vector<std::string>& columns, const std::vector<std::vector<BatchValue>>& rows, size_t maxBytes, size_t maxRows) {
+    std::vector<size_t> rowBytes;
+    rowBytes.reserve(rows.size());
+    for (const auto& row : rows) {
+        if (row.size() != columns.size()) {
+            throw std::invalid_argument("Batch row does not match the column list of " + table);
+        }
+        size_t bytes = 0;
+        for (const auto& value : row) {
+            bytes += std::holds_alternative<std::string>(value) ? std::get<std::string>(value).size() + 4 : 8;
+        }
+        rowBytes.push_back(bytes);
+    }
+
+    std::string prefix = "INSERT INTO " + table + " (";
+    std::string tuple = "(";
+    for (size_t i = 0; i < columns.size(); i++) {
+        prefix += i == 0 ? columns[i] : ", " + columns[i];
+        tuple += i == 0 ? "?" : ", ?";
+    }
+    prefix += ") VALUES ";
+    tuple += ")";
+
+    size_t done = 0;
+    while (done < rows.size()) {
+        size_t chunk = 1;
+        while (chunk * 2 <= std::min(rows.size() - done, maxRows)) {
+            chunk *= 2;
+        }
+        while (chunk > 1) {
+            size_t bytes = 0;
+            for (size_t i = done; i < done + chunk; i++) {
+                bytes += rowBytes[i];
+            }
+            if (bytes <= maxBytes) {
+                break;
+            }
+            chunk /= 2;
+        }
+
+        std::string query = prefix;
+        for (size_t i = 0; i < chunk; i++) {
+            query += i == 0 ? tuple : ", " + tuple;
+        }
+        std::unique_ptr<PooledStatement> pstmt(prepareStatement(query));
+        unsigned int index = 1;
+        for (size_t i = done; i < done + chunk; i++) {
+            for (const auto& value : rows[i]) {
+                if (std::holds_alternative<std::string>(value)) {
+                    pstmt->setString(index++, std::get<std::string>(value));
+                } else {
+                    pstmt->setInt64(index++, std::get<int64_t>(value));
+                }
+            }
+        }
+        pstmt->executeUpdate();
+        done += chunk;
+    }
+    return done;
+}
+
+size_t APIs::inArity(size_t count) {
+    size_t arity = 1;
+    while (arity < count) {
+        arity <<= 1;
+    }
+    return count == 0 ? 0 : arity;
+}
+
+std::string APIs::inPlaceholders(size_t count) {
+    std::string placeholders;
+    size_t arity = inArity(count);
+    for (size_t i = 0; i < arity; i++) {
+        placeholders += i == 0 ? "?" : ", ?";
+    }
+    return placeholders;
+}
+
+APIs::StatementCacheStats APIs::statementCacheStats() const {
+    return {statement_cache_hits.load(), statement_cache_misses.load()};
+}
+
+APIs::TransactionStats APIs::transactionStats() const {
+    return {transaction_count.load(), transaction_total_us.load(), transaction_max_us.load()};
+}
+
+size_t APIs::healthyReplicaCount() const {
+    int64_t now = ticks(std::chrono::steady_clock::now());
+    return std::count_if(replicas.begin(), replicas.end(), [now](const std::unique_ptr<Replica>& replica) {
+        return now >= replica->down_until;
+    });
+}
@@ -12,38 +12,259 @@
 #include <cppconn/resultset.h>
 #include <cppconn/statement.h>
 #include <cppconn/prepared_statement.h>
+#include <atomic>
+#include <chrono>
 #include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <variant>
+#include <vector>
+
+#include "connection_pool.hpp"
+#include "query_stats.hpp"
+
+class APIs;
+
+/**
+ * @class PooledStatement
+ * @brief A prepared statement that keeps its pooled connection checked out while it is alive.
+ *
+ * Forwards the parameter setters and execute calls to the underlying sql::PreparedStatement.
+ * On destruction the statement goes back to its connection's StatementCache, and the connection
+ * is given back to the pool once every other holder of it (e.g. an open transaction) is gone.
+ *
+ * @note A result set must not outlive the statement it came from: once the statement is back in
+ * the cache it can be re-executed for the next user of the same SQL text.
+ */
+class PooledStatement {
+private:
+    ConnectionPool::Handle connection; /**< The connection the statement was prepared on. Declared first so it outlives the statement. */
+    std::unique_ptr<sql::PreparedStatement> statement; /**< The prepared statement. */
+    std::string query; /**< The SQL text, used as the statement cache key. */
+    APIs* writer; /**< The APIs object to notify when the statement writes, nullptr for statements prepared as reads. */
+    QueryStats* stats; /**< Where executions are recorded. */
+    uint64_t pending_wait_us; /**< Connection wait not yet charged to an execution. */
+    uint64_t pending_prepare_us; /**< Prepare time not yet charged to an execution. */
+
+    /**
+     * @brief Records an execution that started at `start`, charging the pending wait and prepare time to the first one.
+     * @param failed The execution threw.
+     */
+    void record(std::chrono::steady_clock::time_point start, int64_t rows, bool failed = false);
+
+public:
+    /**
+     * @brief Wraps a statement prepared on a pooled connection.
+     * @param connection The connection the statement was prepared on.
+     * @param statement The prepared statement.
+     * @param query The SQL text the statement was prepared from.
+     * @param writer The APIs object to notify when the statement writes, or nullptr.
+     * @param stats Where executions are recorded.
+     * @param wait_us Time spent waiting for the connection.
+     * @param prepare_us Time spent preparing the statement on the server, 0 on a statement cache hit.
+     */
+    PooledStatement(ConnectionPool::Handle connection, std::unique_ptr<sql::PreparedStatement> statement, std::string query, APIs* writer, QueryStats* stats, uint64_t wait_us, uint64_t prepare_us);
+
+    /**
+     * @brief Returns the statement to its connection's cache.
+     */
+    ~PooledStatement();
+
+    PooledStatement(const PooledStatement&) = delete;
+    PooledStatement& operator=(const PooledStatement&) = delete;
+
+    void setInt(unsigned int parameterIndex, int32_t value) { statement->setInt(parameterIndex, value); }
+    void setUInt(unsigned int parameterIndex, uint32_t value) { statement->setUInt(parameterIndex, value); }
+    void setInt64(unsigned int parameterIndex, int64_t value) { statement->setInt64(parameterIndex, value); }
+    void setUInt64(unsigned int parameterIndex, uint64_t value) { statement->setUInt64(parameterIndex, value); }
+    void setBigInt(unsigned int parameterIndex, const sql::SQLString& value) { statement->setBigInt(parameterIndex, value); }
+    void setBoolean(unsigned int parameterIndex, bool value) { statement->setBoolean(parameterIndex, value); }
+    void setDouble(unsigned int parameterIndex, double value) { statement->setDouble(parameterIndex, value); }
+    void setString(unsigned int parameterIndex, const sql::SQLString& value) { statement->setString(parameterIndex, value); }
+    void setDateTime(unsigned int parameterIndex, const sql::SQLString& value) { statement->setDateTime(parameterIndex, value); }
+    void setNull(unsigned int parameterIndex, int sqlType) { statement->setNull(parameterIndex, sqlType); }
+    void clearParameters() { statement->clearParameters(); }
+
+    /**
+     * @brief Binds the values of an `IN (...)` list built with APIs::inPlaceholders().
+     *
+     * The last value is repeated into the padding slots, which does not change the result of `IN`.
+     *
+     * @param firstIndex The parameter index of the first placeholder of the list.
+     * @param values The values of the list.
+     * @return The parameter index following the list.
+     */
+    unsigned int setStringList(unsigned int firstIndex, const std::vector<std::string>& values);
+
+    /**
+     * @brief Executes the statement and returns its result set. The caller owns the result set.
+     */
+    sql::ResultSet* executeQuery();
+
+    /**
+     * @brief Executes the statement.
+     * @return true if the first result is a result set.
+     */
+    bool execute();
+
+    /**
+     * @brief Executes the statement.
+     * @return The number of rows affected.
+     */
+    int executeUpdate();
+
+    bool getMoreResults() { return statement->getMoreResults(); }
+    sql::ResultSet* getResultSet() { return statement->getResultSet(); }
+};
+
+/**
+ * @class PooledResultSet
+ * @brief The result set of APIs::read(), holding its statement and pooled connection until it is destroyed.
+ *
+ * The connection only goes back to the pool once the rows have been read, so no other thread can
+ * run a query on it while the result set is still in use.
+ */
+class PooledResultSet {
+private:
+    ConnectionPool::Handle connection; /**< The connection the query ran on. Declared first so it outlives the statement and rows. */
+    std::unique_ptr<sql::Statement> statement; /**< The statement the rows came from. */
+    std::unique_ptr<sql::ResultSet> result; /**< The rows. */
+
+public:
+    PooledResultSet(ConnectionPool::Handle connection, std::unique_ptr<sql::Statement> statement, std::unique_ptr<sql::ResultSet> result)
+        : connection(std::move(connection)), statement(std::move(statement)), result(std::move(result)) {}
+
+    sql::ResultSet* operator->() const { return result.get(); }
+    sql::ResultSet& operator*() const { return *result; }
+    sql::ResultSet* get() const { return result.get(); }
+};
 
 /**
  * @class APIs
  * @brief A class that provides an interface for interacting with a MySQL database.
- * 
- * not using connection pool because it is not necessary for this project
- * the onlinejudge is designed to be used by a small number of users
+ *
+ * Every call checks a connection out of a ConnectionPool, so queries from different Crow worker
+ * threads run in parallel. A transaction binds one connection to the calling thread from
+ * beginTransaction() until commitTransaction() or rollbackTransaction(); every statement that
+ * thread prepares in between runs on that connection.
+ *
+ * Every query is timed into queryStats(), with the wait for a pooled connection kept apart from
+ * the time spent on the server.
+ *
+ * Writes and transactions always go to the primary. read() and statements prepared with
+ * Access::Read are spread round-robin over the healthy replicas, falling back to the primary when
+ * there are none. A replica that cannot be connected to is skipped for a cooldown period; one whose
+ * pool is merely exhausted is passed over without waiting, and only the final fallback to the
+ * primary blocks for a free connection.
  */
 class APIs {
+public:
+    /**
+     * @brief Where a prepared statement may run.
+     */
+    enum class Access {
+        Write, /**< On the primary. The default, and required for anything that must see the latest data. */
+        Read /**< On a replica, unless the calling thread has an open transaction or read-your-writes applies. */
+    };
+
+    /**
+     * @class ReadYourWrites
+     * @brief Keeps a user's reads on the primary right after the user wrote something.
+     *
+     * Create one on the stack at the start of a request handler. While it is alive, reads on the
+     * calling thread go to the primary if this request already wrote, or if a request with the
+     * same key wrote within the configured window, so replica lag never hides a user's own rows.
+     */
+    class ReadYourWrites {
+    public:
+        /**
+         * @brief Opens a read-your-writes scope on the calling thread.
+         * @param api The APIs object the scope applies to.
+         * @param key Identifies the writer across requests, usually the user ID.
+         */
+        ReadYourWrites(APIs& api, int64_t key);
+        ~ReadYourWrites();
+
+        ReadYourWrites(const ReadYourWrites&) = delete;
+        ReadYourWrites& operator=(const ReadYourWrites&) = delete;
+
+    private:
+        friend class APIs;
+        APIs& api; /**< The APIs object the scope applies to. */
+        int64_t key; /**< Identifies the writer across requests. */
+        bool wrote = false; /**< Set once this request wrote through api. */
+        ReadYourWrites* previous; /**< The scope that was active on this thread before this one. */
+    };
+
 private:
-    sql::mysql::MySQL_Driver *driver; /**< The MySQL driver object. */
-    std::unique_ptr<sql::Connection> con; /**< The MySQL connection object. */
-    std::recursive_mutex mtx; /**< A mutex to ensure thread safety. */
+    /**
+     * @struct Replica
+     * @brief A read replica and its health.
+     */
+    struct Replica {
+        std::shared_ptr<ConnectionPool> pool; /**< The replica's connections. */
+        std::atomic<int64_t> down_until{0}; /**< steady_clock ticks until which the replica is skipped. */
+    };
+
+    std::shared_ptr<ConnectionPool> pool; /**< The primary's connections. */
+    std::vector<std::unique_ptr<Replica>> replicas; /**< The read replicas. */
+    std::atomic<size_t> next_replica{0}; /**< Round-robin position over replicas. */
+    std::chrono::seconds replica_cooldown{30}; /**< How long a replica that could not be connected to is skipped. */
+    std::chrono::seconds read_your_writes_window; /**< How long a key's reads stay on the primary after a write. */
+    std::mutex recent_writes_mtx; /**< Guards recent_writes. */
+    std::unordered_map<int64_t, std::chrono::steady_clock::time_point> recent_writes; /**< Last write per read-your-writes key. */
+    std::mutex transactions_mtx; /**< Guards transactions. */
+    std::unordered_map<std::thread::id, ConnectionPool::Handle> transactions; /**< The connection bound to each thread with an open transaction. */
+    std::atomic<uint64_t> statement_cache_hits{0}; /**< prepareStatement() calls served from a statement cache. */
+    std::atomic<uint64_t> statement_cache_misses{0}; /**< prepareStatement() calls that prepared on the server. */
+    QueryStats query_stats; /**< Latency per statement fingerprint and the slow-query log. */
+    std::atomic<uint64_t> transaction_count{0}; /**< Transactions committed or rolled back. */
+    std::atomic<uint64_t> transaction_total_us{0}; /**< Summed time transactions held their connection. */
+    std::atomic<uint64_t> transaction_max_us{0}; /**< Longest time a transaction held its connection. */
+
+    /**
+     * @brief Adds a finished transaction to the transaction counters.
+     */
+    void recordTransaction(const PooledConnection& con);
+
+    /**
+     * @brief Returns the connection of the calling thread's open transaction, or a freshly checked out one.
+     */
+    ConnectionPool::Handle connection();
+
+    /**
+     * @brief Returns the calling thread's transaction connection, a replica connection, or a primary one.
+     */
+    ConnectionPool::Handle readConnection();
+
+    /**
+     * @brief Returns true if read-your-writes requires the calling thread to read from the primary.
+     */
+    bool stickyToPrimary();
+
+    /**
+     * @brief Records a write for the calling thread's read-your-writes scope.
+     */
+    void noteWrite();
+
+    friend class PooledStatement;
 
 public:
     /**
-     * @brief Constructs an APIs object with the specified MySQL connection details.
-     * @param SQL_host The hostname of the MySQL server.
-     * @param SQL_user The username for the MySQL server.
-     * @param SQL_password The password for the MySQL server.
-     * @param SQL_database The name of the MySQL database.
-     * @param SQL_port The port number for the MySQL server.
+     * @brief Constructs an APIs object and opens its connection pools.
+     * @param config The connection details and pool sizing of the primary.
+     * @param replicaConfigs The connection details and pool sizing of each read replica.
+     * @param readYourWritesWindow How long a ReadYourWrites key keeps reading from the primary after a write.
      */
-    APIs(const std::string& SQL_host, const std::string& SQL_user, const std::string& SQL_password, const std::string& SQL_database, int SQL_port);
+    explicit APIs(const ConnectionPool::Config& config, const std::vector<ConnectionPool::Config>& replicaConfigs = {}, std::chrono::seconds readYourWritesWindow = std::chrono::seconds(5));
 
     /**
-     * @brief Executes a read query on the MySQL database.
+     * @brief Executes a read query on the MySQL database, on a replica if one is healthy.
      * @param query The SQL query to execute.
-     * @return A unique pointer to the result set of the query.
+     * @return The result set of the query; the connection stays checked out while it is alive.
      */
-    std::unique_ptr<sql::ResultSet> read(const std::string& query);
+    PooledResultSet read(const std::string& query);
 
     /**
      * @brief Executes a write query on the MySQL database.
@@ -54,14 +275,118 @@ public:
 
     /**
      * @brief Prepares a statement for execution on the MySQL database.
+     *
+     * Statements are cached per connection by SQL text, so repeated calls with the same query skip
+     * the server-side prepare. Build dynamic `IN (...)` lists with inPlaceholders() so they are
+     * cached as well.
+     *
      * @param query The SQL query to prepare.
+     * @param access Access::Read to allow the statement to run on a replica. Only use it for
+     * SELECTs that can tolerate replication lag.
      * @return A unique pointer to the prepared statement.
      */
-    std::unique_ptr<sql::PreparedStatement> prepareStatement(const std::string& query);
+    std::unique_ptr<PooledStatement> prepareStatement(const std::string& query, Access access = Access::Write);
 
+    /** A value of a row passed to insertBatch(). */
+    using BatchValue = std::variant<int64_t, std::string>;
+
+    /**
+     * @brief Inserts rows with multi-row `INSERT ... VALUES (...), (...)` statements.
+     *
+     * Rows are sent in chunks of a power-of-two number of rows, at most `maxRows`, so the handful
+     * of statement texts stay in the statement cache. A chunk is halved until its estimated size
+     * fits in `maxBytes`, which should stay below the server's max_allowed_packet; a single row
+     * larger than that is still sent on its own. Runs in the calling thread's transaction if one
+     * is open.
+     *
+     * @param table The table to insert into. Not escaped, so never pass user input.
+     * @param columns The columns of each row, in order. Not escaped either.
+     * @param rows The rows, each with one value per column.
+     * @param maxBytes The size cap of one statement's bound values.
+     * @param maxRows The maximum number of rows per statement.
+     * @return The number of rows inserted.
+     * @throws std::invalid_argument if a row does not have one value per column.
+     */
+    size_t insertBatch(const std::string& table, const std::vector<std::string>& columns, const std::vector<std::vector<BatchValue>>& rows, size_t maxBytes = 1 << 20, size_t maxRows = 64);
+
+    /**
+     * @brief Starts a transaction on a connection bound to the calling thread.
+     * @throws std::runtime_error if the thread already has an open transaction.
+     */
     void beginTransaction();
 
+    /**
+     * @brief Commits the calling thread's transaction and releases its connection.
+     * @throws std::runtime_error if the thread has no open transaction.
+     */
     void commitTransaction();
 
+    /**
+     * @brief Rolls back the calling thread's transaction and releases its connection.
+     * Does nothing if the thread has no open transaction.
+     */
     void rollbackTransaction();
+
+    /**
+     * @brief Returns the number of placeholders used for an `IN (...)` list of `count` values.
+     *
+     * `count` is rounded up to a power of two so lists of different lengths share a handful of
+     * statement texts in the statement cache.
+     */
+    static size_t inArity(size_t count);
+
+    /**
+     * @brief Builds the placeholder list "?, ?, ..." for an `IN (...)` list of `count` values.
+     * Bind the values with PooledStatement::setStringList().
+     */
+    static std::string inPlaceholders(size_t count);
+
+    /**
+     * @struct StatementCacheStats
+     * @brief Hit and miss counters of the statement caches of all pooled connections.
+     */
+    struct StatementCacheStats {
+        uint64_t hits;
+        uint64_t misses;
+    };
+
+    /**
+     * @brief Returns the statement cache counters.
+     */
+    StatementCacheStats statementCacheStats() const;
+
+    /**
+     * @struct TransactionStats
+     * @brief How long transactions held their connection, from begin to commit or rollback.
+     */
+    struct TransactionStats {
+        uint64_t count;
+        uint64_t total_us;
+        uint64_t max_us;
+    };
+
+    /**
+     * @brief Returns the transaction counters.
+     */
+    TransactionStats transactionStats() const;
+
+    /**
+     * @brief Returns the query latency statistics and slow-query log.
+     */
+    QueryStats& queryStats() { return query_stats; }
+
+    /**
+     * @brief Returns the pool backing this object.
+     */
+    const std::shared_ptr<ConnectionPool>& connectionPool() const { return pool; }
+
+    /**
+     * @brief Returns the number of configured read replicas.
+     */
+    size_t replicaCount() const { return replicas.size(); }
+
+    /**
+     * @brief Returns the number of read replicas that are not in their failure cooldown.
+     */
+    size_t healthyReplicaCount() const;
 };
@@ -0,0 +1,174 @@
+/**
+ * @file connection_pool.cpp
+ * @brief Implementation of the ConnectionPool class.
+ */
+
+#include "connection_pool.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+ConnectionPool::ConnectionPool(const Config& config) : config(config) {
+    driver = sql::mysql::get_mysql_driver_instance();
+    if (this->config.max_size == 0) {
+        this->config.max_size = 1;
+    }
+    this->config.min_size = std::min(this->config.min_size, this->config.max_size);
+}
+
+std::shared_ptr<ConnectionPool> ConnectionPool::create(const Config& config) {
+    std::shared_ptr<ConnectionPool> pool(new ConnectionPool(config));
+    for (size_t i = 0; i < pool->config.min_size; i++) {
+        pool->idle.push_back(pool->connect());
+        pool->total++;
+    }
+    pool->reaper = std::thread(&ConnectionPool::reapLoop, pool.get());
+    return pool;
+}
+
+ConnectionPool::~ConnectionPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    reaper_cv.notify_all();
+    if (reaper.joinable()) {
+        reaper.join();
+    }
+}
+
+std::unique_ptr<PooledConnection> ConnectionPool::connect() {
+    std::string hostWithPort = config.host + ":" + std::to_string(config.port);
+    auto connection = std::make_unique<PooledConnection>();
+    connection->con = std::unique_ptr<sql::Connection>(driver->connect(hostWithPort, config.user, config.password));
+    connection->con->setSchema(config.database);
+    connection->statements = StatementCache(config.statement_cache_size);
+    connection->last_used = connection->last_validated = std::chrono::steady_clock::now();
+    return connection;
+}
+
+bool ConnectionPool::validate(PooledConnection& connection) {
+    auto now = std::chrono::steady_clock::now();
+    if (now - connection.last_validated < config.validation_interval) {
+        return true;
+    }
+    try {
+        if (!connection.con->isValid()) {
+            return false;
+        }
+    } catch (const sql::SQLException& e) {
+        return false;
+    }
+    connection.last_validated = now;
+    return true;
+}
+
+ConnectionPool::Handle ConnectionPool::wrap(std::unique_ptr<PooledConnection> connection) {
+    std::weak_ptr<ConnectionPool> weak = shared_from_this();
+    return Handle(connection.release(), [weak](PooledConnection* raw) {
+        std::unique_ptr<PooledConnection> connection(raw);
+        if (auto pool = weak.lock()) {
+            pool->release(std::move(connection));
+        }
+    });
+}
+
+ConnectionPool::Handle ConnectionPool::acquire() {
+    Handle connection = checkout(std::chrono::steady_clock::now() + config.wait_timeout);
+    if (!connection) {
+        throw std::runtime_error("Timed out waiting for a database connection");
+    }
+    return connection;
+}
+
+ConnectionPool::Handle ConnectionPool::tryAcquire() {
+    return checkout(std::chrono::steady_clock::now());
+}
+
+ConnectionPool::Handle ConnectionPool::checkout(std::chrono::steady_clock::time_point deadline) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        if (!idle.empty()) {
+            std::unique_ptr<PooledConnection> connection = std::move(idle.back());
+            idle.pop_back();
+            lock.unlock();
+            if (validate(*connection)) {
+                return wrap(std::move(connection));
+            }
+            connection.reset();
+            lock.lock();
+            total--;
+            continue;
+        }
+        if (total < config.max_size) {
+            total++;
+            lock.unlock();
+            try {
+                return wrap(connect());
+            } catch (...) {
+                lock.lock();
+                total--;
+                available.notify_one();
+                throw;
+            }
+        }
+        if (available.wait_until(lock, deadline) == std::cv_status::timeout && idle.empty() && total >= config.max_size) {
+            return nullptr;
+        }
+    }
+}
+
+void ConnectionPool::release(std::unique_ptr<PooledConnection> connection) {
+    // a handle dropped in the middle of a transaction must not leak it to the next user
+    if (connection->in_transaction && !connection->broken) {
+        try {
+            connection->con->rollback();
+            connection->con->setAutoCommit(true);
+            connection->in_transaction = false;
+        } catch (const sql::SQLException& e) {
+            connection->broken = true;
+        }
+    }
+    if (connection->broken) {
+        connection.reset();
+        std::lock_guard<std::mutex> lock(mtx);
+        total--;
+        available.notify_one();
+        return;
+    }
+    connection->last_used = std::chrono::steady_clock::now();
+    std::lock_guard<std::mutex> lock(mtx);
+    idle.push_back(std::move(connection));
+    available.notify_one();
+}
+
+void ConnectionPool::reapLoop() {
+    auto interval = std::max<std::chrono::seconds>(std::chrono::seconds(1), std::min<std::chrono::seconds>(config.idle_timeout, std::chrono::seconds(30)));
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!reaper_cv.wait_for(lock, interval, [this] { return stopping; })) {
+        auto now = std::chrono::steady_clock::now();
+        std::deque<std::unique_ptr<PooledConnection>> expired;
+        // the least recently used connections are at the front
+        while (!idle.empty() && total > config.min_size && now - idle.front()->last_used >= config.idle_timeout) {
+            expired.push_back(std::move(idle.front()));
+            idle.pop_front();
+            total--;
+        }
+        if (!expired.empty()) {
+            available.notify_all();
+            lock.unlock();
+            expired.clear();
+            lock.lock();
+        }
+    }
+}
+
+size_t ConnectionPool::size() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return total;
+}
+
+size_t ConnectionPool::idleCount() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return idle.size();
+}
@@ -0,0 +1,152 @@
+/**
+ * @file connection_pool.hpp
+ * @brief Header file for the ConnectionPool class.
+ */
+
+#pragma once
+
+#include <mysql_driver.h>
+#include <mysql_connection.h>
+#include <cppconn/driver.h>
+#include <cppconn/exception.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+
+#include "statement_cache.hpp"
+
+/**
+ * @struct PooledConnection
+ * @brief A MySQL connection owned by a ConnectionPool together with its bookkeeping.
+ */
+struct PooledConnection {
+    std::unique_ptr<sql::Connection> con; /**< The MySQL connection object. */
+    StatementCache statements; /**< Statements prepared on this connection. Declared after con so it is destroyed first. */
+    std::chrono::steady_clock::time_point last_used; /**< When the connection was last returned to the pool. */
+    std::chrono::steady_clock::time_point last_validated; /**< When the connection was last known to be alive. */
+    bool in_transaction = false; /**< True while autocommit is disabled on the connection. */
+    std::chrono::steady_clock::time_point transaction_started; /**< When the open transaction began. */
+    bool broken = false; /**< Set when the connection must not be handed out again, e.g. after the server connection was lost. */
+};
+
+/**
+ * @class ConnectionPool
+ * @brief A bounded, thread-safe pool of MySQL connections.
+ *
+ * Connections are checked out with acquire() and go back to the pool when the last copy of the
+ * returned handle is destroyed. The pool keeps at least `min_size` connections open, never opens
+ * more than `max_size`, closes connections that stayed idle for longer than `idle_timeout` and
+ * pings connections that have not been used for `validation_interval` before handing them out.
+ */
+class ConnectionPool : public std::enable_shared_from_this<ConnectionPool> {
+public:
+    /** A checked out connection. Returned to the pool when the last copy is destroyed. */
+    using Handle = std::shared_ptr<PooledConnection>;
+
+    /**
+     * @struct Config
+     * @brief Connection details and sizing of a pool.
+     */
+    struct Config {
+        std::string host; /**< The hostname of the MySQL server. */
+        std::string user; /**< The username for the MySQL server. */
+        std::string password; /**< The password for the MySQL server. */
+        std::string database; /**< The name of the MySQL database. */
+        int port = 3306; /**< The port number for the MySQL server. */
+        size_t min_size = 2; /**< Connections opened at startup and kept open while idle. */
+        size_t max_size = 16; /**< Upper bound of open connections. */
+        std::chrono::seconds idle_timeout{300}; /**< Idle connections above min_size are closed after this. */
+        std::chrono::milliseconds wait_timeout{5000}; /**< How long acquire() waits for a free connection. */
+        std::chrono::seconds validation_interval{30}; /**< Connections idle for longer are pinged on checkout. */
+        size_t statement_cache_size = 64; /**< Prepared statements cached per connection; 0 disables the cache. */
+    };
+
+    /**
+     * @brief Creates a pool and opens its first `min_size` connections.
+     * @param config The connection details and sizing of the pool.
+     * @return A shared pointer to the created pool.
+     * @throws sql::SQLException if a connection cannot be opened.
+     */
+    static std::shared_ptr<ConnectionPool> create(const Config& config);
+
+    ~ConnectionPool();
+
+    ConnectionPool(const ConnectionPool&) = delete;
+    ConnectionPool& operator=(const ConnectionPool&) = delete;
+
+    /**
+     * @brief Checks out a validated connection, opening a new one if the pool is not full.
+     * @return A handle to the connection.
+     * @throws std::runtime_error if no connection became available within `wait_timeout`.
+     * @throws sql::SQLException if a new connection cannot be opened.
+     */
+    Handle acquire();
+
+    /**
+     * @brief Checks out a connection like acquire(), but does not wait when every connection is busy.
+     * @return A handle to the connection, or an empty handle if the pool is full and none is idle.
+     * @throws sql::SQLException if a new connection cannot be opened.
+     */
+    Handle tryAcquire();
+
+    /**
+     * @brief Returns the number of open connections, idle or checked out.
+     */
+    size_t size() const;
+
+    /**
+     * @brief Returns the number of idle connections.
+     */
+    size_t idleCount() const;
+
+private:
+    explicit ConnectionPool(const Config& config);
+
+    /**
+     * @brief Checks out a validated connection, waiting for one to be released until `deadline`.
+     * @return A handle to the connection, or an empty handle if none became available in time.
+     * @throws sql::SQLException if a new connection cannot be opened.
+     */
+    Handle checkout(std::chrono::steady_clock::time_point deadline);
+
+    /**
+     * @brief Opens a new connection to the server.
+     */
+    std::unique_ptr<PooledConnection> connect();
+
+    /**
+     * @brief Pings the connection if it has not been used for `validation_interval`.
+     * @return false if the connection is dead and has to be discarded.
+     */
+    bool validate(PooledConnection& connection);
+
+    /**
+     * @brief Wraps a connection in a handle that gives it back to this pool.
+     */
+    Handle wrap(std::unique_ptr<PooledConnection> connection);
+
+    /**
+     * @brief Puts a connection back into the idle list, or closes it if it is broken.
+     */
+    void release(std::unique_ptr<PooledConnection> connection);
+
+    /**
+     * @brief Periodically closes connections that stayed idle for longer than `idle_timeout`.
+     */
+    void reapLoop();
+
+    Config config; /**< The connection details and sizing of the pool. */
+    sql::mysql::MySQL_Driver *driver; /**< The MySQL driver object. */
+    mutable std::mutex mtx; /**< Guards idle, total and stopping. */
+    std::condition_variable available; /**< Signalled whenever a connection is released or closed. */
+    std::condition_variable reaper_cv; /**< Wakes the reaper thread on shutdown. */
+    std::deque<std::unique_ptr<PooledConnection>> idle; /**< Idle connections, most recently used at the back. */
+    size_t total = 0; /**< Open connections, including the ones being opened. */
+    bool stopping = false; /**< Set by the destructor to stop the reaper thread. */
+    std::thread reaper; /**< The idle connection reaper. */
+};
@@ -0,0 +1,65 @@
+/**
+ * @file db_executor.cpp
+ * @brief Implementation of the DBExecutor class.
+ */
+
+#include "db_executor.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+DBExecutor::DBExecutor(size_t threads, size_t max_queue) : max_queue(max_queue) {
+    threads = std::max<size_t>(threads, 1);
+    for (size_t i = 0; i < threads; i++) {
+        workers.emplace_back(&DBExecutor::work, this);
+    }
+}
+
+DBExecutor::~DBExecutor() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool DBExecutor::post(std::function<void()> job) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping || jobs.size() >= max_queue) {
+            rejected++;
+            return false;
+        }
+        jobs.push_back(std::move(job));
+    }
+    cv.notify_one();
+    return true;
+}
+
+size_t DBExecutor::queueDepth() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return jobs.size();
+}
+
+void DBExecutor::work() {
+    while (true) {
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this] { return stopping || !jobs.empty(); });
+            if (jobs.empty()) {
+                return;
+            }
+            job = std::move(jobs.front());
+            jobs.pop_front();
+        }
+        try {
+            job();
+        } catch (const std::exception& e) {
+            std::cerr << "Database job failed: " << e.what() << std::endl;
+        }
+    }
+}
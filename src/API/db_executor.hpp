@@ -0,0 +1,104 @@
+/**
+ * @file db_executor.hpp
+ * @brief Header file for the DBExecutor class.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <stdexcept>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+/**
+ * @class DBExecutor
+ * @brief A fixed pool of threads that run database jobs off the Crow worker threads.
+ *
+ * Jobs are queued up to `max_queue`; beyond that they are rejected so callers can shed load
+ * (e.g. answer 503) instead of piling up requests behind a slow query.
+ */
+class DBExecutor {
+public:
+    /**
+     * @class QueueFull
+     * @brief Thrown by submit() when the job queue is full.
+     */
+    class QueueFull : public std::runtime_error {
+    public:
+        QueueFull() : std::runtime_error("Database job queue is full") {}
+    };
+
+    /**
+     * @brief Starts the worker threads.
+     * @param threads The number of worker threads, at least one.
+     * @param max_queue The maximum number of jobs waiting for a worker.
+     */
+    DBExecutor(size_t threads, size_t max_queue);
+
+    /**
+     * @brief Runs the jobs still queued, then stops the worker threads.
+     */
+    ~DBExecutor();
+
+    DBExecutor(const DBExecutor&) = delete;
+    DBExecutor& operator=(const DBExecutor&) = delete;
+
+    /**
+     * @brief Queues a job.
+     * @param job The job to run on a worker thread. Exceptions it throws are discarded.
+     * @return false if the queue is full and the job was not queued.
+     */
+    bool post(std::function<void()> job);
+
+    /**
+     * @brief Queues a job and returns a future for its result.
+     * @param job The job to run on a worker thread.
+     * @return A future holding the job's return value or exception.
+     * @throws QueueFull if the queue is full.
+     */
+    template<typename F>
+    std::future<std::invoke_result_t<F>> submit(F&& job) {
+        auto task = std::make_shared<std::packaged_task<std::invoke_result_t<F>()>>(std::forward<F>(job));
+        std::future<std::invoke_result_t<F>> result = task->get_future();
+        if (!post([task] { (*task)(); })) {
+            throw QueueFull();
+        }
+        return result;
+    }
+
+    /**
+     * @brief Returns the number of jobs waiting for a worker.
+     */
+    size_t queueDepth() const;
+
+    /**
+     * @brief Returns the number of worker threads.
+     */
+    size_t threadCount() const { return workers.size(); }
+
+    /**
+     * @brief Returns the number of jobs rejected because the queue was full.
+     */
+    uint64_t rejectedCount() const { return rejected.load(); }
+
+private:
+    /**
+     * @brief The loop run by every worker thread.
+     */
+    void work();
+
+    size_t max_queue; /**< The maximum number of jobs waiting for a worker. */
+    mutable std::mutex mtx; /**< Guards jobs and stopping. */
+    std::condition_variable cv; /**< Signalled when a job is queued or the executor stops. */
+    std::deque<std::function<void()>> jobs; /**< Jobs waiting for a worker. */
+    bool stopping = false; /**< Set by the destructor. */
+    std::atomic<uint64_t> rejected{0}; /**< Jobs rejected because the queue was full. */
+    std::vector<std::thread> workers; /**< The worker threads. */
+};
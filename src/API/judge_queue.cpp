@@ -0,0 +1,464 @@
+/**
+ * @file judge_queue.cpp
+ * @brief Implementation of the JudgeQueue class.
+ */
+
+#include "judge_queue.hpp"
+
+#include <algorithm>
+#include <exception>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <unordered_set>
+
+namespace {
+uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+
+// the most test cases sent at once in the first_failure mode
+constexpr size_t first_failure_max_step = 16;
+
+// chunks that may wait per chunk thread before workers run their chunks themselves
+constexpr size_t chunk_backlog = 4;
+
+// count test cases of all from start, or fewer at the end
+nlohmann::json slice(const nlohmann::json& all, size_t start, size_t count) {
+    return nlohmann::json(all.begin() + start, all.begin() + std::min(start + count, all.size()));
+}
+
+// a streaming node answers one JSON line per test case and the whole result as the last line
+std::string lastLine(const std::string& body) {
+    size_t end = body.find_last_not_of("\r\n");
+    if (end == std::string::npos) {
+        return body;
+    }
+    size_t start = body.find_last_of('\n', end);
+    start = start == std::string::npos ? 0 : start + 1;
+    return body.substr(start, end + 1 - start);
+}
+}
+
+const char* JudgeQueue::priorityName(Priority priority) {
+    switch (priority) {
+        case Priority::Contest: return "contest";
+        case Priority::Practice: return "practice";
+        case Priority::Rejudge: return "rejudge";
+    }
+    return "unknown";
+}
+
+JudgeQueue::JudgeQueue(APIs& api, SandboxPool& sandbox, TestCaseCache& test_cases, VerdictHub& hub, VerdictCache& verdicts, size_t workers, size_t max_queue, std::array<size_t, priority_count> max_in_flight, size_t chunk_threads)
+    : api(api), sandbox(sandbox), test_cases(test_cases), hub(hub), verdicts(verdicts), max_queue(max_queue),
+      chunk_pool(std::max<size_t>(chunk_threads == 0 ? workers : chunk_threads, 1), std::max<size_t>(chunk_threads == 0 ? workers : chunk_threads, 1) * chunk_backlog) {
+    workers = std::max<size_t>(workers, 1);
+    for (size_t i = 0; i < priority_count; i++) {
+        classes[i].max_in_flight = max_in_flight[i] == 0 ? workers : std::min(max_in_flight[i], workers);
+    }
+    for (size_t i = 0; i < workers; i++) {
+        this->workers.emplace_back(&JudgeQueue::work, this);
+    }
+}
+
+JudgeQueue::~JudgeQueue() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    for (auto& worker : workers) {
+        worker.join();
+    }
+}
+
+bool JudgeQueue::enqueue(Job job) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping || queued >= max_queue) {
+            rejected++;
+            return false;
+        }
+        ClassQueue& queue = classes[static_cast<size_t>(job.priority)];
+        std::deque<Job>& userJobs = queue.users[job.user_id];
+        if (userJobs.empty()) {
+            queue.turns.push_back(job.user_id);
+        }
+        // opened before a worker can take the job, so its events are never published unopened
+        hub.open(job.submission_id, job.user_id);
+        userJobs.push_back(std::move(job));
+        queue.size++;
+        queued++;
+    }
+    // a worker may be waiting for a different class that is at its cap
+    cv.notify_all();
+    return true;
+}
+
+size_t JudgeQueue::recoverPending() {
+    std::string query = "SELECT id, problem_id, language, code, user_id FROM problem_submissions WHERE status = 'Pending' ORDER BY id;";
+    std::unique_ptr<PooledStatement> pstmt(api.prepareStatement(query));
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    size_t recovered = 0;
+    while (res->next()) {
+        // whether it was a contest submission is not stored, so it is queued as practice
+        if (!enqueue({res->getInt64("id"), res->getInt("problem_id"), res->getString("language"), res->getString("code"), res->getInt("user_id")})) {
+            break;
+        }
+        recovered++;
+    }
+    return recovered;
+}
+
+std::optional<nlohmann::json> JudgeQueue::cachedVerdict(int problem_id, const std::string& language, const std::string& source_code) {
+    return verdicts.get(VerdictCache::key(problem_id, test_cases.version(problem_id), language, source_code));
+}
+
+std::optional<size_t> JudgeQueue::position(int64_t submission_id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    size_t ahead = 0;
+    for (const ClassQueue& queue : classes) {
+        for (size_t turn = 0; turn < queue.turns.size(); turn++) {
+            const std::deque<Job>& userJobs = queue.users.at(queue.turns[turn]);
+            for (size_t index = 0; index < userJobs.size(); index++) {
+                if (userJobs[index].submission_id != submission_id) {
+                    continue;
+                }
+                // users take turns one job at a time: every other user gets as many jobs in
+                // before this one as this user has ahead of it, plus one if their turn comes first
+                ahead += index;
+                for (size_t other = 0; other < queue.turns.size(); other++) {
+                    if (other != turn) {
+                        ahead += std::min(queue.users.at(queue.turns[other]).size(), index + (other < turn ? 1 : 0));
+                    }
+                }
+                return ahead + 1;
+            }
+        }
+        ahead += queue.size;
+    }
+    return std::nullopt;
+}
+
+std::optional<int> JudgeQueue::owner(int64_t submission_id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const ClassQueue& queue : classes) {
+        for (const auto& [user_id, userJobs] : queue.users) {
+            for (const Job& job : userJobs) {
+                if (job.submission_id == submission_id) {
+                    return user_id;
+                }
+            }
+        }
+    }
+    return std::nullopt;
+}
+
+JudgeQueue::Stats JudgeQueue::stats() const {
+    Stats stats{workers.size(), 0, in_flight.load(), completed.load(), failed.load(), rejected.load(),
+                wait_us_total.load(), wait_us_max.load(), judge_us_total.load(),
+                chunk_pool.threadCount(), chunk_pool.queueDepth(), chunk_pool.rejectedCount(), {}};
+    std::lock_guard<std::mutex> lock(mtx);
+    stats.queue_depth = queued;
+    for (size_t i = 0; i < priority_count; i++) {
+        stats.classes[i] = {classes[i].size, classes[i].turns.size(), classes[i].in_flight, classes[i].max_in_flight};
+    }
+    return stats;
+}
+
+JudgeQueue::ClassQueue* JudgeQueue::nextClass() {
+    for (ClassQueue& queue : classes) {
+        if (queue.size > 0 && queue.in_flight < queue.max_in_flight) {
+            return &queue;
+        }
+    }
+    return nullptr;
+}
+
+void JudgeQueue::work() {
+    QueryStats::Route route("judge");
+    while (true) {
+        Job job;
+        ClassQueue* queue;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this, &queue] { return stopping || (queue = nextClass()) != nullptr; });
+            if (stopping) {
+                return;
+            }
+            // the user whose turn it is gives up one job and goes to the back if they have more
+            int user_id = queue->turns.front();
+            queue->turns.pop_front();
+            auto userJobs = queue->users.find(user_id);
+            job = std::move(userJobs->second.front());
+            userJobs->second.pop_front();
+            if (userJobs->second.empty()) {
+                queue->users.erase(userJobs);
+            } else {
+                queue->turns.push_back(user_id);
+            }
+            queue->size--;
+            queue->in_flight++;
+            queued--;
+        }
+        uint64_t wait_us = elapsedUs(job.enqueued_at);
+        wait_us_total += wait_us;
+        uint64_t max = wait_us_max.load();
+        while (wait_us > max && !wait_us_max.compare_exchange_weak(max, wait_us)) {}
+
+        in_flight++;
+        auto start = std::chrono::steady_clock::now();
+        judge(job);
+        judge_us_total += elapsedUs(start);
+        in_flight--;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            queue->in_flight--;
+        }
+        // the class may have been at its cap with jobs waiting
+        cv.notify_all();
+    }
+}
+
+void JudgeQueue::judge(const Job& job) {
+    try {
+        std::shared_ptr<const TestCaseCache::Bundle> bundle = test_cases.get(job.problem_id, [this, &job] {
+            return loadProblem(job.problem_id);
+        });
+        const nlohmann::json& all = bundle->test_cases;
+        if (all.empty()) {
+            // nothing to pass is not a pass
+            throw std::runtime_error("Problem " + std::to_string(job.problem_id) + " has no test cases");
+        }
+        hub.publish(job.submission_id, {{"type", "judging"}});
+        nlohmann::json result;
+        if (bundle->mode == "first_failure") {
+            // growing steps: a wrong answer usually fails early, an accepted one needs few round trips
+            result = emptyResult();
+            for (size_t start = 0, step = 1; start < all.size(); start += step, step = std::min(step * 2, first_failure_max_step)) {
+                nlohmann::json part = dispatch(job, *bundle, slice(all, start, step), forwarder(job));
+                mergeResult(result, part);
+                if (part["status"] != "Accepted") {
+                    break;
+                }
+            }
+        } else if (bundle->chunk_size > 0 && all.size() > bundle->chunk_size) {
+            // the chunks run at once on whichever nodes have free slots; this worker runs the first,
+            // the chunk threads the others, and this worker again those the chunk pool has no room for
+            std::vector<std::future<nlohmann::json>> parts;
+            for (size_t start = bundle->chunk_size; start < all.size(); start += bundle->chunk_size) {
+                auto send = [this, &job, &bundle, chunk = slice(all, start, bundle->chunk_size)] {
+                    return dispatch(job, *bundle, chunk, forwarder(job));
+                };
+                try {
+                    parts.push_back(chunk_pool.submit(send));
+                } catch (const DBExecutor::QueueFull&) {
+                    parts.push_back(std::async(std::launch::deferred, send));
+                }
+            }
+            result = emptyResult();
+            std::exception_ptr error;
+            try {
+                mergeResult(result, dispatch(job, *bundle, slice(all, 0, bundle->chunk_size), forwarder(job)));
+            } catch (...) {
+                error = std::current_exception();
+            }
+            // wait for every chunk before leaving, they refer to the job
+            for (auto& part : parts) {
+                if (error && part.wait_for(std::chrono::seconds(0)) == std::future_status::deferred) {
+                    // not started; the submission has failed already
+                    continue;
+                }
+                try {
+                    nlohmann::json partResult = part.get();
+                    if (!error) {
+                        mergeResult(result, partResult);
+                    }
+                } catch (...) {
+                    if (!error) {
+                        error = std::current_exception();
+                    }
+                }
+            }
+            if (error) {
+                std::rethrow_exception(error);
+            }
+        } else {
+            result = dispatch(job, *bundle, all, forwarder(job));
+        }
+        result["score"] = awardedScore(*bundle, result);
+        if (job.on_done) {
+            job.on_done(&result);
+        } else {
+            storeVerdict(job.submission_id, result);
+        }
+        completed++;
+        // keyed by the version judged against, so a test case update in the meantime is not hit
+        verdicts.put(VerdictCache::key(job.problem_id, bundle->version, job.language, job.source_code), {
+            {"status", result["status"]},
+            {"score", result["score"]},
+            {"time_taken", result["time_taken"]},
+            {"memory_taken", result["memory_taken"]},
+            {"subtasks", result.value("subtasks", nlohmann::json::array())}
+        });
+        hub.close(job.submission_id, {
+            {"type", "verdict"},
+            {"status", result["status"]},
+            {"score", result["score"]},
+            {"time_taken", result["time_taken"]},
+            {"memory_taken", result["memory_taken"]}
+        });
+    } catch (const std::exception& e) {
+        std::cerr << "Judging submission " << job.submission_id << " failed: " << e.what() << std::endl;
+        failed++;
+        if (job.on_done) {
+            job.on_done(nullptr);
+        } else {
+            markRejected(job.submission_id);
+        }
+        hub.close(job.submission_id, {{"type", "verdict"}, {"status", "Rejected"}});
+    }
+}
+
+nlohmann::json JudgeQueue::dispatch(const Job& job, const TestCaseCache::Bundle& bundle, const nlohmann::json& test_cases, const sand_box_api::DataCallback& on_data) {
+    nlohmann::json payload = {
+        {"source_code", job.source_code},
+        {"language", job.language},
+        {"test_cases", test_cases},
+        {"stream", true}
+    };
+    // the test cases go by hash; the node asks for the contents it does not hold yet
+    std::string response = sandbox.POST(payload, &bundle.blobs, on_data);
+    // expect : json object with each test case id and status, time_taken, memory_taken
+    return nlohmann::json::parse(lastLine(response));
+}
+
+sand_box_api::DataCallback JudgeQueue::forwarder(const Job& job) {
+    // forward each complete test case line as it arrives
+    auto partial = std::make_shared<std::string>();
+    return [this, submission_id = job.submission_id, partial](std::string_view chunk, bool first) {
+        if (first) {
+            partial->clear();
+        }
+        partial->append(chunk);
+        size_t newline;
+        while ((newline = partial->find('\n')) != std::string::npos) {
+            nlohmann::json line = nlohmann::json::parse(partial->substr(0, newline), nullptr, false);
+            partial->erase(0, newline + 1);
+            if (line.is_object() && line.contains("id") && !line.contains("subtasks")) {
+                line["type"] = "test_case";
+                hub.publish(submission_id, std::move(line));
+            }
+        }
+    };
+}
+
+nlohmann::json JudgeQueue::emptyResult() {
+    return {{"status", "Accepted"}, {"score", 0}, {"time_taken", 0}, {"memory_taken", 0}, {"subtasks", nlohmann::json::array()}};
+}
+
+void JudgeQueue::mergeResult(nlohmann::json& total, const nlohmann::json& part) {
+    // the first failing part decides the status and the peaks are kept
+    if (total["status"] == "Accepted") {
+        total["status"] = part["status"];
+    }
+    total["time_taken"] = std::max(total["time_taken"].get<int>(), part["time_taken"].get<int>());
+    total["memory_taken"] = std::max(total["memory_taken"].get<int>(), part["memory_taken"].get<int>());
+    for (const auto& subtask : part.value("subtasks", nlohmann::json::array())) {
+        total["subtasks"].push_back(subtask);
+    }
+}
+
+int JudgeQueue::awardedScore(const TestCaseCache::Bundle& bundle, const nlohmann::json& result) {
+    std::unordered_set<int> passed;
+    int score = 0;
+    for (const auto& subtask : result.value("subtasks", nlohmann::json::array())) {
+        int id = subtask["id"].get<int>();
+        auto scored = bundle.scores.find(id);
+        if (subtask["status"] == "Accepted" && scored != bundle.scores.end() && passed.insert(id).second) {
+            score += scored->second;
+        }
+    }
+    return score;
+}
+
+nlohmann::json JudgeQueue::loadProblem(int problem_id) {
+    std::string mode = "all";
+    int chunk_size = 0;
+    {
+        std::unique_ptr<PooledStatement> pstmt(api.prepareStatement("SELECT judge_mode, judge_chunk_size FROM problems WHERE id = ?;"));
+        pstmt->setInt(1, problem_id);
+        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+        if (res->next()) {
+            mode = res->getString("judge_mode");
+            chunk_size = std::max(res->getInt("judge_chunk_size"), 0);
+        }
+    }
+    std::string query = "SELECT id, input, output, time_limit, memory_limit, score FROM problem_test_cases WHERE problem_id = ?;";
+    if (mode == "first_failure") {
+        // the test cases failed most often first, then the cheapest
+        query = R"(
+            SELECT t.id, t.input, t.output, t.time_limit, t.memory_limit, t.score,
+                (SELECT COUNT(*) FROM problem_submissions_subtasks s WHERE s.test_case_id = t.id AND s.status <> 'Accepted') AS failures
+            FROM problem_test_cases t
+            WHERE t.problem_id = ?
+            ORDER BY failures DESC, t.time_limit, t.id;
+        )";
+    }
+    std::unique_ptr<PooledStatement> pstmt(api.prepareStatement(query));
+    pstmt->setInt(1, problem_id);
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    nlohmann::json test_cases = nlohmann::json::array();
+    while (res->next()) {
+        test_cases.push_back({
+            {"id", res->getInt("id")},
+            {"in", std::string(res->getString("input"))},
+            {"ou", std::string(res->getString("output"))},
+            {"ti", res->getInt("time_limit")},
+            {"me", res->getInt("memory_limit")},
+            {"sc", res->getInt("score")}
+        });
+    }
+    return {{"mode", mode}, {"chunk_size", chunk_size}, {"test_cases", std::move(test_cases)}};
+}
+
+void JudgeQueue::storeVerdict(int64_t submission_id, const nlohmann::json& result) {
+    std::vector<std::vector<APIs::BatchValue>> subtasks;
+    for (const auto& subtask : result.value("subtasks", nlohmann::json::array())) {
+        subtasks.push_back({
+            submission_id,
+            int64_t(subtask["id"].get<int>()),
+            subtask["status"].get<std::string>(),
+            int64_t(subtask["time_taken"].get<int>()),
+            int64_t(subtask["memory_taken"].get<int>())
+        });
+    }
+    try {
+        api.beginTransaction();
+        std::string query = "UPDATE problem_submissions SET status = ?, score = ?, time_taken = ?, memory_taken = ? WHERE id = ?;";
+        std::unique_ptr<PooledStatement> pstmt(api.prepareStatement(query));
+        pstmt->setString(1, result["status"].get<std::string>());
+        pstmt->setInt(2, result["score"].get<int>());
+        pstmt->setInt(3, result["time_taken"].get<int>());
+        pstmt->setInt(4, result["memory_taken"].get<int>());
+        pstmt->setInt64(5, submission_id);
+        pstmt->execute();
+        pstmt.reset();
+        api.insertBatch("problem_submissions_subtasks", {"submission_id", "test_case_id", "status", "time_taken", "memory_taken"}, subtasks);
+        api.commitTransaction();
+    } catch (...) {
+        api.rollbackTransaction();
+        throw;
+    }
+}
+
+void JudgeQueue::markRejected(int64_t submission_id) {
+    try {
+        std::string query = "UPDATE problem_submissions SET status = 'Rejected' WHERE id = ?;";
+        std::unique_ptr<PooledStatement> pstmt(api.prepareStatement(query));
+        pstmt->setInt64(1, submission_id);
+        pstmt->execute();
+    } catch (const std::exception& e) {
+        std::cerr << "Could not mark submission " << submission_id << " as rejected: " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,283 @@
+/**
+ * @file judge_queue.hpp
+ * @brief Header file for the JudgeQueue class.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "api.hpp"
+#include "db_executor.hpp"
+#include "sandbox_pool.hpp"
+#include "test_case_cache.hpp"
+#include "verdict_cache.hpp"
+#include "verdict_hub.hpp"
+
+/**
+ * @class JudgeQueue
+ * @brief Judges submissions in the background so /submit returns as soon as the row is stored.
+ *
+ * /submit inserts the submission with status Pending and enqueues it. A fixed pool of judge
+ * workers takes the test cases from the TestCaseCache, sends the job to the sandbox and writes
+ * the verdict and the per test case results back. Progress is published on the VerdictHub:
+ * "judging" when a worker takes the job, "test_case" for each verdict the sandbox streams back
+ * and "verdict" at the end. Problems in the "first_failure" mode are sent in growing steps and
+ * judging stops at the first step that is not Accepted. Problems with a chunk size are split into
+ * chunks of that many test cases, judged at once on several nodes and merged in test case order;
+ * the worker runs the first chunk and hands the others to a fixed pool of chunk threads shared by
+ * all workers, running them itself when that pool is backed up.
+ * The score is computed here from the test cases that passed, never taken from the nodes, since
+ * they only see part of the test cases and not their scores. A problem without test cases is
+ * not judged; its submissions end up Rejected like any other judging failure.
+ * Verdicts are remembered in the VerdictCache so identical resubmissions can skip the sandbox.
+ * Submissions left Pending by a previous run are picked up again by
+ * recoverPending().
+ *
+ * Jobs are served by priority class first: a worker takes a contest job before a practice job
+ * and a practice job before a rejudge, skipping a class that already has its max_in_flight jobs
+ * being judged. Within a class the users take turns, one job each, so a user resubmitting many
+ * times only delays their own submissions.
+ */
+class JudgeQueue {
+public:
+    /**
+     * @enum Priority
+     * @brief The priority classes, served in this order.
+     */
+    enum class Priority { Contest, Practice, Rejudge };
+    static constexpr size_t priority_count = 3;
+
+    /**
+     * @brief Returns the lowercase name of a priority class, as used in the settings and metrics.
+     */
+    static const char* priorityName(Priority priority);
+
+    /**
+     * @struct Job
+     * @brief A stored submission waiting to be judged.
+     */
+    struct Job {
+        int64_t submission_id;
+        int problem_id;
+        std::string language;
+        std::string source_code;
+        int user_id = 0; /**< The submitter, whose jobs take turns with the other users' jobs. */
+        Priority priority = Priority::Practice;
+        /**
+         * If set, called by the worker with the sandbox result instead of storing the verdict, or
+         * with nullptr instead of marking the submission Rejected. Used to batch rejudge writes.
+         */
+        std::function<void(const nlohmann::json* result)> on_done;
+        std::chrono::steady_clock::time_point enqueued_at = std::chrono::steady_clock::now(); /**< Used for the wait-time metrics. */
+    };
+
+    /**
+     * @struct ClassStats
+     * @brief Counters of one priority class.
+     */
+    struct ClassStats {
+        size_t queue_depth; /**< Jobs of the class waiting for a worker. */
+        size_t users; /**< Users with jobs of the class waiting. */
+        size_t in_flight; /**< Jobs of the class being judged. */
+        size_t max_in_flight; /**< The most jobs of the class judged at once. */
+    };
+
+    /**
+     * @struct Stats
+     * @brief Queue and worker counters.
+     */
+    struct Stats {
+        size_t workers; /**< Judge worker threads. */
+        size_t queue_depth; /**< Jobs waiting for a worker. */
+        size_t in_flight; /**< Jobs being judged. */
+        uint64_t completed; /**< Jobs whose verdict was stored. */
+        uint64_t failed; /**< Jobs marked Rejected because judging or storing the verdict failed. */
+        uint64_t rejected; /**< Jobs not queued because the queue was full. */
+        uint64_t wait_us_total; /**< Summed time jobs waited for a worker. */
+        uint64_t wait_us_max; /**< Longest time a job waited for a worker. */
+        uint64_t judge_us_total; /**< Summed time workers spent on jobs. */
+        size_t chunk_threads; /**< Threads sending the further chunks of chunked problems. */
+        size_t chunk_queue_depth; /**< Chunks waiting for a chunk thread. */
+        uint64_t chunks_inline; /**< Chunks a worker ran itself because the chunk pool was full. */
+        std::array<ClassStats, priority_count> classes; /**< Indexed by Priority. */
+    };
+
+    /**
+     * @brief Starts the judge workers.
+     * @param api The database the submissions live in.
+     * @param sandbox The sandbox nodes the jobs are sent to.
+     * @param test_cases The cache the test cases are read through.
+     * @param hub Where the progress of the submissions is published.
+     * @param verdicts Where the verdicts are remembered for identical resubmissions.
+     * @param workers The number of jobs judged at once, at least one.
+     * @param max_queue The maximum number of jobs waiting for a worker.
+     * @param max_in_flight The most jobs of each priority class judged at once, indexed by Priority; 0 allows every worker.
+     * @param chunk_threads Threads sending the further chunks of chunked problems, over all workers; 0 uses one per worker.
+     */
+    JudgeQueue(APIs& api, SandboxPool& sandbox, TestCaseCache& test_cases, VerdictHub& hub, VerdictCache& verdicts, size_t workers, size_t max_queue, std::array<size_t, priority_count> max_in_flight = {}, size_t chunk_threads = 0);
+
+    /**
+     * @brief Stops the workers once their current job is done. Queued jobs stay Pending in the
+     * database and are recovered on the next start.
+     */
+    ~JudgeQueue();
+
+    JudgeQueue(const JudgeQueue&) = delete;
+    JudgeQueue& operator=(const JudgeQueue&) = delete;
+
+    /**
+     * @brief Queues a submission.
+     * @param job The stored submission.
+     * @return false if the queue is full and the job was not queued.
+     */
+    bool enqueue(Job job);
+
+    /**
+     * @brief Queues every submission still Pending in the database, oldest first.
+     * @return The number of submissions queued.
+     */
+    size_t recoverPending();
+
+    /**
+     * @brief Returns the place of a queued submission in the order the workers will take the
+     * jobs queued now, starting at 1.
+     * @return std::nullopt if the submission is not waiting, e.g. it is being judged or done.
+     */
+    std::optional<size_t> position(int64_t submission_id) const;
+
+    /**
+     * @brief Returns the submitter of a queued submission.
+     * @return std::nullopt if the submission is not waiting.
+     */
+    std::optional<int> owner(int64_t submission_id) const;
+
+    /**
+     * @brief Returns the verdict of byte-identical code judged against the current test cases.
+     * @return {status, score, time_taken, memory_taken, subtasks}, or std::nullopt if there is none.
+     */
+    std::optional<nlohmann::json> cachedVerdict(int problem_id, const std::string& language, const std::string& source_code);
+
+    /**
+     * @brief Returns the queue and worker counters.
+     */
+    Stats stats() const;
+
+    /**
+     * @brief Returns the counters of the verdict cache.
+     */
+    VerdictCache::Stats verdictStats() const { return verdicts.stats(); }
+
+    /**
+     * @brief Returns the state of the sandbox nodes.
+     */
+    std::vector<SandboxPool::NodeStats> sandboxStats() const { return sandbox.stats(); }
+
+private:
+    /**
+     * @struct ClassQueue
+     * @brief The jobs of one priority class, queued per user.
+     */
+    struct ClassQueue {
+        std::unordered_map<int, std::deque<Job>> users; /**< Jobs per user, oldest first. */
+        std::deque<int> turns; /**< Users with queued jobs, the next one to be served first. */
+        size_t size = 0; /**< Jobs queued in the class. */
+        size_t in_flight = 0; /**< Jobs of the class being judged. */
+        size_t max_in_flight = 0; /**< The most jobs of the class judged at once. */
+    };
+
+    /**
+     * @brief Returns the class a worker should take its next job from. Requires mtx.
+     * @return nullptr if no class has a job and room for one more in flight.
+     */
+    ClassQueue* nextClass();
+
+    /**
+     * @brief The loop run by every judge worker.
+     */
+    void work();
+
+    /**
+     * @brief Judges one submission and stores its verdict.
+     */
+    void judge(const Job& job);
+
+    /**
+     * @brief Sends some test cases of a bundle to the sandbox and returns the parsed result.
+     */
+    nlohmann::json dispatch(const Job& job, const TestCaseCache::Bundle& bundle, const nlohmann::json& test_cases, const sand_box_api::DataCallback& on_data);
+
+    /**
+     * @brief Returns a callback publishing the test case lines of one sandbox response on the hub.
+     */
+    sand_box_api::DataCallback forwarder(const Job& job);
+
+    /**
+     * @brief Returns the result of judging no test cases, to merge parts into. Never a verdict on its own.
+     */
+    static nlohmann::json emptyResult();
+
+    /**
+     * @brief Adds the result of judging some test cases to the result of the submission. The
+     * score of the part is ignored; see awardedScore().
+     */
+    static void mergeResult(nlohmann::json& total, const nlohmann::json& part);
+
+    /**
+     * @brief Returns the summed score of the test cases of a result that were Accepted.
+     */
+    static int awardedScore(const TestCaseCache::Bundle& bundle, const nlohmann::json& result);
+
+    /**
+     * @brief Loads the judging settings and the test cases of a problem, in judging order, on a
+     * TestCaseCache miss. In the "first_failure" mode the test cases failed most often come
+     * first, then the cheapest. Reads the primary, since the result is cached under the version
+     * current after the last manage panel write.
+     */
+    nlohmann::json loadProblem(int problem_id);
+
+    /**
+     * @brief Stores the verdict of a submission and its per test case results.
+     */
+    void storeVerdict(int64_t submission_id, const nlohmann::json& result);
+
+    /**
+     * @brief Marks a submission Rejected after judging it failed.
+     */
+    void markRejected(int64_t submission_id);
+
+    APIs& api; /**< The database the submissions live in. */
+    SandboxPool& sandbox; /**< The sandbox nodes the jobs are sent to. */
+    TestCaseCache& test_cases; /**< The cache the test cases are read through. */
+    VerdictHub& hub; /**< Where the progress of the submissions is published. */
+    VerdictCache& verdicts; /**< Where the verdicts are remembered for identical resubmissions. */
+    size_t max_queue; /**< The maximum number of jobs waiting for a worker. */
+    mutable std::mutex mtx; /**< Guards classes, queued and stopping. */
+    std::condition_variable cv; /**< Signalled when a job is queued or finished, or the queue stops. */
+    std::array<ClassQueue, priority_count> classes; /**< Jobs waiting for a worker, indexed by Priority. */
+    size_t queued = 0; /**< Jobs waiting for a worker over all classes. */
+    bool stopping = false; /**< Set by the destructor. */
+    std::atomic<size_t> in_flight{0}; /**< Jobs being judged. */
+    std::atomic<uint64_t> completed{0}; /**< Jobs whose verdict was stored. */
+    std::atomic<uint64_t> failed{0}; /**< Jobs marked Rejected. */
+    std::atomic<uint64_t> rejected{0}; /**< Jobs not queued because the queue was full. */
+    std::atomic<uint64_t> wait_us_total{0}; /**< Summed time jobs waited for a worker. */
+    std::atomic<uint64_t> wait_us_max{0}; /**< Longest time a job waited for a worker. */
+    std::atomic<uint64_t> judge_us_total{0}; /**< Summed time workers spent on jobs. */
+    DBExecutor chunk_pool; /**< Sends the chunks after the first; bounded, so chunked problems cannot spawn threads without limit. */
+    std::vector<std::thread> workers; /**< The judge workers. */
+};
@@ -0,0 +1,77 @@
+/**
+ * @file permission_index.cpp
+ * @brief Implementation of the PermissionIndex class.
+ */
+#include "permission_index.hpp"
+
+#include <algorithm>
+#include <mutex>
+
+void PermissionIndex::load(APIs& api) {
+    std::unordered_map<int, std::vector<Grant>> loaded;
+    std::unique_ptr<PooledStatement> pstmt(api.prepareStatement("SELECT problem_id, role_name, permission_flags FROM problem_role;"));
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    while (res->next()) {
+        loaded[res->getInt("problem_id")].push_back({RoleNames::intern(res->getString("role_name")), static_cast<uint32_t>(res->getInt("permission_flags"))});
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    grants = std::move(loaded);
+}
+
+void PermissionIndex::reload(APIs& api, int problem_id) {
+    reloads++;
+    uint64_t version;
+    {
+        std::unique_lock<std::shared_mutex> lock(mtx);
+        version = ++versions[problem_id];
+    }
+    // read from the primary, the change was just committed there
+    std::vector<Grant> loaded;
+    std::unique_ptr<PooledStatement> pstmt(api.prepareStatement("SELECT role_name, permission_flags FROM problem_role WHERE problem_id = ?;"));
+    pstmt->setInt(1, problem_id);
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    while (res->next()) {
+        loaded.push_back({RoleNames::intern(res->getString("role_name")), static_cast<uint32_t>(res->getInt("permission_flags"))});
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    if (versions[problem_id] != version) {
+        return;
+    }
+    if (loaded.empty()) {
+        grants.erase(problem_id);
+    } else {
+        grants[problem_id] = std::move(loaded);
+    }
+}
+
+bool PermissionIndex::allows(int problem_id, const std::vector<uint32_t>& roles, int permission_flag) const {
+    checks++;
+    const uint32_t mask = 1u << permission_flag;
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    auto it = grants.find(problem_id);
+    if (it == grants.end()) {
+        return false;
+    }
+    for (const Grant& grant : it->second) {
+        if ((grant.flags & mask) && std::find(roles.begin(), roles.end(), grant.role) != roles.end()) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool PermissionIndex::allows(const AuthContext& auth, int problem_id, int permission_flag) const {
+    if (!auth.authenticated) {
+        return false;
+    }
+    return auth.isSiteAdmin() || allows(problem_id, auth.roles, permission_flag);
+}
+
+PermissionIndex::Stats PermissionIndex::stats() const {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    size_t count = 0;
+    for (const auto& [problem_id, problemGrants] : grants) {
+        count += problemGrants.size();
+    }
+    return {grants.size(), count, checks.load(), reloads.load()};
+}
@@ -0,0 +1,81 @@
+/**
+ * @file permission_index.hpp
+ * @brief In-process index of the problem_role table.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <shared_mutex>
+#include <unordered_map>
+#include <vector>
+
+#include "api.hpp"
+#include "../Programs/auth_context.hpp"
+
+/**
+ * @class PermissionIndex
+ * @brief Answers "may this user do X to problem P" without touching the database.
+ *
+ * Every problem maps to the roles granted something on it and the permission bits of each, with
+ * the role names interned by RoleNames the same way as the roles of an AuthContext. The whole
+ * problem_role table is loaded at startup; every write to it goes through the manage panel, which
+ * calls reload() for the problem after committing. A check is a scan of a few grants, comparing
+ * integers and masking bits.
+ */
+class PermissionIndex {
+public:
+    /**
+     * @struct Grant
+     * @brief The permission bits a role holds on a problem.
+     */
+    struct Grant {
+        uint32_t role; /**< Interned role name. */
+        uint32_t flags; /**< problem_role.permission_flags. */
+    };
+
+    /**
+     * @brief Size counters of the index.
+     */
+    struct Stats {
+        size_t problems; /**< Problems with at least one grant. */
+        size_t grants;
+        uint64_t checks; /**< Calls to allows() since startup. */
+        uint64_t reloads; /**< Calls to reload() since startup. */
+    };
+
+    /**
+     * @brief Loads every grant, replacing the index. Call it at startup.
+     */
+    void load(APIs& api);
+
+    /**
+     * @brief Reloads the grants of a problem. Call it after committing a change to its
+     * problem_role rows, creating it or deleting it.
+     */
+    void reload(APIs& api, int problem_id);
+
+    /**
+     * @brief Whether one of the roles holds the permission on the problem.
+     * @param permission_flag The bit index of the permission, as in settings["permission_flags"]["problems"].
+     */
+    bool allows(int problem_id, const std::vector<uint32_t>& roles, int permission_flag) const;
+
+    /**
+     * @brief Whether the user is a site admin or one of their roles holds the permission on the problem.
+     * @return false for an unauthenticated request.
+     */
+    bool allows(const AuthContext& auth, int problem_id, int permission_flag) const;
+
+    /**
+     * @brief Returns the size counters.
+     */
+    Stats stats() const;
+
+private:
+    mutable std::shared_mutex mtx; /**< Guards grants and versions. */
+    std::unordered_map<int, std::vector<Grant>> grants; /**< Grants by problem id; problems without grants are absent. */
+    std::unordered_map<int, uint64_t> versions; /**< Bumped by each reload(), so an older, slower reload does not win. */
+    mutable std::atomic<uint64_t> checks{0}; /**< Calls to allows(). */
+    std::atomic<uint64_t> reloads{0}; /**< Calls to reload(). */
+};
@@ -0,0 +1,150 @@
+/**
+ * @file query_stats.cpp
+ * @brief Implementation of the QueryStats class.
+ */
+
+#include "query_stats.hpp"
+
+#include <algorithm>
+#include <cctype>
+#include <iostream>
+#include <regex>
+
+namespace {
+/** The route of the calling thread. */
+thread_local const char* current_route = nullptr;
+
+bool isIdentifierChar(char c) {
+    return std::isalnum(static_cast<unsigned char>(c)) || c == '_' || c == '$';
+}
+}
+
+QueryStats::Route::Route(const char* name) : previous(current_route) {
+    current_route = name;
+}
+
+QueryStats::Route::~Route() {
+    current_route = previous;
+}
+
+const char* QueryStats::currentRoute() {
+    return current_route;
+}
+
+void QueryStats::setSlowThreshold(std::chrono::milliseconds threshold) {
+    slow_threshold_us = std::chrono::duration_cast<std::chrono::microseconds>(threshold).count();
+}
+
+std::string QueryStats::normalize(const std::string& query) {
+    // replace literals with ? and collapse whitespace
+    std::string sql;
+    sql.reserve(query.size());
+    for (size_t i = 0; i < query.size(); i++) {
+        char c = query[i];
+        if (c == '\'' || c == '"') {
+            size_t end = i + 1;
+            while (end < query.size() && (query[end] != c || (end + 1 < query.size() && query[end + 1] == c))) {
+                end += query[end] == '\\' || query[end] == c ? 2 : 1;
+            }
+            sql += '?';
+            i = std::min(end, query.size());
+        } else if (std::isdigit(static_cast<unsigned char>(c)) && (sql.empty() || !isIdentifierChar(sql.back()))) {
+            while (i + 1 < query.size() && (std::isdigit(static_cast<unsigned char>(query[i + 1])) || query[i + 1] == '.')) {
+                i++;
+            }
+            sql += '?';
+        } else if (std::isspace(static_cast<unsigned char>(c))) {
+            if (!sql.empty() && sql.back() != ' ') {
+                sql += ' ';
+            }
+        } else {
+            sql += c;
+        }
+    }
+    while (!sql.empty() && (sql.back() == ' ' || sql.back() == ';')) {
+        sql.pop_back();
+    }
+    // fold placeholder lists and repeated VALUES tuples
+    static const std::regex list(R"(\?( ?, ?\?)+)");
+    static const std::regex tuples(R"((\([^()]*\))( ?, ?\1)+)");
+    sql = std::regex_replace(sql, list, "?, ...");
+    sql = std::regex_replace(sql, tuples, "$1, ...");
+    return sql;
+}
+
+void QueryStats::record(const std::string& query, uint64_t wait_us, uint64_t exec_us, int64_t rows, bool failed) {
+    std::shared_ptr<Fingerprint> fingerprint;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = by_text.find(query);
+        if (it != by_text.end()) {
+            fingerprint = it->second;
+        }
+    }
+    if (!fingerprint) {
+        std::string sql = normalize(query);
+        unsigned int binds = std::count(query.begin(), query.end(), '?');
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = by_sql.find(sql);
+        if (it == by_sql.end() && by_sql.size() >= max_fingerprints) {
+            it = by_sql.find("other");
+            if (it == by_sql.end()) {
+                auto other = std::make_shared<Fingerprint>();
+                other->sql = "other";
+                it = by_sql.emplace("other", other).first;
+            }
+        } else if (it == by_sql.end()) {
+            auto created = std::make_shared<Fingerprint>();
+            created->sql = sql;
+            created->binds = binds;
+            it = by_sql.emplace(sql, created).first;
+        }
+        fingerprint = it->second;
+        if (by_text.size() < max_texts) {
+            by_text.emplace(query, fingerprint);
+        }
+    }
+
+    size_t bucket = std::lower_bound(bucket_bounds_us.begin(), bucket_bounds_us.end(), exec_us) - bucket_bounds_us.begin();
+    int64_t threshold = slow_threshold_us.load();
+    bool slow = threshold > 0 && wait_us + exec_us >= static_cast<uint64_t>(threshold);
+    const char* route = current_route;
+
+    std::string message;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        fingerprint->count++;
+        fingerprint->errors += failed;
+        fingerprint->wait_us += wait_us;
+        fingerprint->exec_us += exec_us;
+        fingerprint->rows += std::max<int64_t>(rows, 0);
+        fingerprint->buckets[bucket]++;
+        if (slow) {
+            slow_queries.push_back({fingerprint->sql, fingerprint->binds, wait_us, exec_us, rows, failed, route ? route : "", std::chrono::system_clock::now()});
+            if (slow_queries.size() > max_slow_queries) {
+                slow_queries.pop_front();
+            }
+            message = "Slow " + std::string(failed ? "failed " : "") + "query (" + std::to_string(wait_us) + "us wait, " + std::to_string(exec_us) + "us exec, "
+                      + std::to_string(rows) + " rows" + (route ? std::string(", ") + route : std::string()) + "): " + fingerprint->sql;
+        }
+    }
+    // written without the lock, so other queries do not wait on the terminal
+    if (!message.empty()) {
+        std::cerr << message << std::endl;
+    }
+}
+
+std::vector<QueryStats::Fingerprint> QueryStats::fingerprints() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Fingerprint> result;
+    result.reserve(by_sql.size());
+    for (const auto& entry : by_sql) {
+        result.push_back(*entry.second);
+    }
+    return result;
+}
+
+std::vector<QueryStats::SlowQuery> QueryStats::slowQueries() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return std::vector<SlowQuery>(slow_queries.begin(), slow_queries.end());
+}
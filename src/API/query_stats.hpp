@@ -0,0 +1,133 @@
+/**
+ * @file query_stats.hpp
+ * @brief Header file for the QueryStats class.
+ */
+
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class QueryStats
+ * @brief Latency histograms per statement fingerprint and a log of slow queries.
+ *
+ * A fingerprint is the SQL text with literals replaced by `?`, whitespace collapsed and repeated
+ * placeholder lists and VALUES tuples folded, so `IN (?, ?)` and `IN (?, ?, ?, ?)` share one
+ * entry. Time spent waiting for a pooled connection is tracked apart from execution time, which
+ * covers preparing (on a statement cache miss) and running the statement on the server.
+ */
+class QueryStats {
+public:
+    /** Upper bounds of the histogram buckets in microseconds; the last bucket is unbounded. */
+    static constexpr std::array<uint64_t, 15> bucket_bounds_us = {
+        100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 500000, 1000000, 2500000, 5000000
+    };
+
+    /**
+     * @struct Fingerprint
+     * @brief The aggregated numbers of one statement fingerprint.
+     */
+    struct Fingerprint {
+        std::string sql; /**< The normalized SQL text. */
+        unsigned int binds = 0; /**< Number of placeholders in the statement. */
+        uint64_t count = 0; /**< Executions. */
+        uint64_t wait_us = 0; /**< Summed time spent waiting for a connection. */
+        uint64_t exec_us = 0; /**< Summed prepare and execution time. */
+        uint64_t rows = 0; /**< Summed rows returned or affected. */
+        uint64_t errors = 0; /**< Executions that threw; they are included in count and the timings. */
+        std::array<uint64_t, bucket_bounds_us.size() + 1> buckets{}; /**< Executions per exec_us bucket. */
+    };
+
+    /**
+     * @struct SlowQuery
+     * @brief One entry of the slow-query log.
+     */
+    struct SlowQuery {
+        std::string sql; /**< The normalized SQL text. */
+        unsigned int binds; /**< Number of placeholders in the statement. */
+        uint64_t wait_us; /**< Time spent waiting for a connection. */
+        uint64_t exec_us; /**< Prepare and execution time. */
+        int64_t rows; /**< Rows returned or affected, -1 if unknown. */
+        bool failed; /**< The query threw. */
+        std::string route; /**< The route that ran the query, empty if none was set. */
+        std::chrono::system_clock::time_point at; /**< When the query finished. */
+    };
+
+    /**
+     * @class Route
+     * @brief Names the route that the queries of the calling thread belong to.
+     *
+     * Create one on the stack at the top of a route handler. respondAsync() carries the name over
+     * to the executor thread.
+     */
+    class Route {
+    public:
+        /**
+         * @param name The route, e.g. "/problems". Must outlive the scope; pass a string literal.
+         */
+        explicit Route(const char* name);
+        ~Route();
+
+        Route(const Route&) = delete;
+        Route& operator=(const Route&) = delete;
+
+    private:
+        const char* previous; /**< The route that was set on this thread before this one. */
+    };
+
+    /**
+     * @brief Returns the route set on the calling thread, or nullptr.
+     */
+    static const char* currentRoute();
+
+    /**
+     * @brief Sets the threshold above which a query is written to the slow-query log.
+     * @param threshold Wait plus execution time; zero disables the log.
+     */
+    void setSlowThreshold(std::chrono::milliseconds threshold);
+
+    /**
+     * @brief Records one execution.
+     * @param query The SQL text as sent to the server.
+     * @param wait_us Time spent waiting for a connection.
+     * @param exec_us Prepare and execution time.
+     * @param rows Rows returned or affected, -1 if unknown.
+     * @param failed The query threw; exec_us is the time until it did.
+     */
+    void record(const std::string& query, uint64_t wait_us, uint64_t exec_us, int64_t rows, bool failed = false);
+
+    /**
+     * @brief Returns a copy of the aggregated fingerprints.
+     */
+    std::vector<Fingerprint> fingerprints() const;
+
+    /**
+     * @brief Returns a copy of the slow-query log, oldest first.
+     */
+    std::vector<SlowQuery> slowQueries() const;
+
+    /**
+     * @brief Normalizes SQL text into its fingerprint.
+     */
+    static std::string normalize(const std::string& query);
+
+private:
+    static constexpr size_t max_fingerprints = 1024; /**< Further fingerprints are folded into one "other" entry. */
+    static constexpr size_t max_texts = 4096; /**< Bound of the SQL text to fingerprint lookup. */
+    static constexpr size_t max_slow_queries = 100; /**< Entries kept in the slow-query log. */
+
+    mutable std::mutex mtx; /**< Guards everything below. */
+    std::unordered_map<std::string, std::shared_ptr<Fingerprint>> by_text; /**< Raw SQL text to its fingerprint, so normalize() runs once per text. */
+    std::unordered_map<std::string, std::shared_ptr<Fingerprint>> by_sql; /**< Normalized SQL to its fingerprint. */
+    std::deque<SlowQuery> slow_queries; /**< The most recent slow queries. */
+    std::atomic<int64_t> slow_threshold_us{200000}; /**< Slow-query threshold; 0 disables the log. */
+};
@@ -0,0 +1,302 @@
+/**
+ * @file rejudger.cpp
+ * @brief Implementation of the Rejudger class.
+ */
+
+#include "rejudger.hpp"
+
+#include <algorithm>
+#include <iostream>
+
+namespace {
+// finished tasks kept for progress reports
+constexpr size_t max_tasks = 100;
+
+struct Submission {
+    int64_t id;
+    std::string language;
+    std::string code;
+    int user_id;
+    std::string status;
+};
+}
+
+Rejudger::Rejudger(APIs& api, JudgeQueue& queue, const Config& config)
+    : api(api), queue(queue), config(config) {
+    this->config.rate_per_second = std::max(this->config.rate_per_second, 0.001);
+    this->config.max_outstanding = std::max<size_t>(this->config.max_outstanding, 1);
+    this->config.batch_size = std::max<size_t>(this->config.batch_size, 1);
+    worker = std::thread(&Rejudger::loop, this);
+}
+
+Rejudger::~Rejudger() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    cv.notify_all();
+    worker.join();
+}
+
+uint64_t Rejudger::start(int problem_id) {
+    auto task = std::make_shared<Task>();
+    task->progress = {0, problem_id, "waiting", "", 0, 0, 0, 0, 0, std::chrono::system_clock::now()};
+    uint64_t id;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        id = task->progress.id = next_id++;
+        tasks.push_back(task);
+        // forget the oldest finished tasks
+        for (auto it = tasks.begin(); tasks.size() > max_tasks && it != tasks.end();) {
+            const std::string& state = (*it)->progress.state;
+            if (state == "done" || state == "cancelled" || state == "failed") {
+                it = tasks.erase(it);
+            } else {
+                ++it;
+            }
+        }
+    }
+    cv.notify_all();
+    return id;
+}
+
+size_t Rejudger::cancel(int problem_id) {
+    size_t cancelled = 0;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        for (const auto& task : tasks) {
+            const std::string& state = task->progress.state;
+            if (task->progress.problem_id == problem_id && (state == "waiting" || state == "running") && !task->cancelled) {
+                task->cancelled = true;
+                if (state == "waiting") {
+                    task->progress.state = "cancelled";
+                }
+                cancelled++;
+            }
+        }
+    }
+    cv.notify_all();
+    return cancelled;
+}
+
+std::vector<Rejudger::Progress> Rejudger::progress(int problem_id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    std::vector<Progress> result;
+    for (auto it = tasks.rbegin(); it != tasks.rend(); ++it) {
+        if ((*it)->progress.problem_id == problem_id) {
+            result.push_back((*it)->progress);
+        }
+    }
+    return result;
+}
+
+void Rejudger::loop() {
+    QueryStats::Route route("rejudge");
+    while (true) {
+        std::shared_ptr<Task> task;
+        {
+            std::unique_lock<std::mutex> lock(mtx);
+            cv.wait(lock, [this, &task] {
+                for (const auto& candidate : tasks) {
+                    if (candidate->progress.state == "waiting") {
+                        task = candidate;
+                        return true;
+                    }
+                }
+                return stopping;
+            });
+            if (stopping) {
+                return;
+            }
+            task->progress.state = "running";
+        }
+        run(task);
+    }
+}
+
+void Rejudger::run(const std::shared_ptr<Task>& task) {
+    const int problem_id = task->progress.problem_id;
+    const auto interval = std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(1.0 / config.rate_per_second));
+    auto nextSlot = std::chrono::steady_clock::now();
+    auto lastFlush = std::chrono::steady_clock::now();
+    std::string error;
+    try {
+        {
+            std::unique_ptr<PooledStatement> pstmt(api.prepareStatement("SELECT COUNT(*) AS total FROM problem_submissions WHERE problem_id = ? AND status <> 'Pending';", APIs::Access::Read));
+            pstmt->setInt(1, problem_id);
+            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+            std::lock_guard<std::mutex> lock(mtx);
+            task->progress.total = res->next() ? res->getInt64("total") : 0;
+        }
+        int64_t after = 0;
+        bool done = false;
+        while (!done) {
+            // read a chunk and release the connection before waiting on the throttle
+            std::vector<Submission> chunk;
+            {
+                std::string query = "SELECT id, language, code, user_id, status FROM problem_submissions WHERE problem_id = ? AND id > ? AND status <> 'Pending' ORDER BY id LIMIT ?;";
+                std::unique_ptr<PooledStatement> pstmt(api.prepareStatement(query, APIs::Access::Read));
+                pstmt->setInt(1, problem_id);
+                pstmt->setInt64(2, after);
+                pstmt->setInt(3, static_cast<int>(config.chunk_size));
+                std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+                while (res->next()) {
+                    chunk.push_back({res->getInt64("id"), res->getString("language"), res->getString("code"), res->getInt("user_id"), res->getString("status")});
+                }
+            }
+            if (chunk.empty()) {
+                break;
+            }
+            after = chunk.back().id;
+
+            for (Submission& submission : chunk) {
+                bool unwritten;
+                {
+                    std::lock_guard<std::mutex> lock(mtx);
+                    unwritten = !task->results.empty();
+                }
+                if (unwritten && std::chrono::steady_clock::now() - lastFlush >= config.flush_interval) {
+                    flush(task);
+                    lastFlush = std::chrono::steady_clock::now();
+                }
+                {
+                    std::unique_lock<std::mutex> lock(mtx);
+                    // at most rate_per_second, and at most max_outstanding in the judge queue at once
+                    cv.wait_until(lock, nextSlot, [this, &task] { return task->cancelled || stopping; });
+                    cv.wait(lock, [this, &task] { return task->cancelled || stopping || task->outstanding < config.max_outstanding; });
+                    if (task->cancelled || stopping) {
+                        done = true;
+                        break;
+                    }
+                    task->outstanding++;
+                    task->old_status[submission.id] = submission.status;
+                }
+                nextSlot = std::max(nextSlot + interval, std::chrono::steady_clock::now());
+
+                JudgeQueue::Job job{submission.id, problem_id, std::move(submission.language), std::move(submission.code), submission.user_id, JudgeQueue::Priority::Rejudge};
+                int64_t submission_id = submission.id;
+                job.on_done = [this, task, submission_id](const nlohmann::json* result) {
+                    report(task, submission_id, result);
+                };
+                bool queued = queue.enqueue(job);
+                while (!queued) {
+                    // the judge queue is full of live submissions; back off
+                    std::unique_lock<std::mutex> lock(mtx);
+                    if (cv.wait_for(lock, std::chrono::milliseconds(200), [this, &task] { return task->cancelled || stopping; })) {
+                        break;
+                    }
+                    lock.unlock();
+                    queued = queue.enqueue(job);
+                }
+                std::lock_guard<std::mutex> lock(mtx);
+                if (!queued) {
+                    task->outstanding--;
+                    task->old_status.erase(submission_id);
+                    done = true;
+                    break;
+                }
+                task->progress.queued++;
+            }
+        }
+    } catch (const std::exception& e) {
+        std::cerr << "Rejudging problem " << problem_id << " failed: " << e.what() << std::endl;
+        error = e.what();
+    }
+
+    // the queued submissions are judged even if the task was cancelled; their callbacks hold the task
+    std::unique_lock<std::mutex> lock(mtx);
+    while (task->outstanding > 0) {
+        cv.wait_for(lock, config.flush_interval, [&task] { return task->outstanding == 0; });
+        lock.unlock();
+        flush(task);
+        lock.lock();
+    }
+    lock.unlock();
+    flush(task);
+    lock.lock();
+    task->progress.error = error;
+    task->progress.state = !error.empty() ? "failed" : task->cancelled ? "cancelled" : "done";
+}
+
+void Rejudger::report(const std::shared_ptr<Task>& task, int64_t submission_id, const nlohmann::json* result) {
+    bool full;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        task->outstanding--;
+        if (result) {
+            task->results.emplace_back(submission_id, *result);
+        } else {
+            task->progress.failed++;
+            task->old_status.erase(submission_id);
+        }
+        full = task->results.size() >= config.batch_size;
+    }
+    cv.notify_all();
+    if (full) {
+        flush(task);
+    }
+}
+
+void Rejudger::flush(const std::shared_ptr<Task>& task) {
+    std::vector<std::pair<int64_t, nlohmann::json>> batch;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        batch.swap(task->results);
+    }
+    if (batch.empty()) {
+        return;
+    }
+    std::vector<std::vector<APIs::BatchValue>> subtasks;
+    for (const auto& [submission_id, result] : batch) {
+        for (const auto& subtask : result.value("subtasks", nlohmann::json::array())) {
+            subtasks.push_back({
+                submission_id,
+                int64_t(subtask["id"].get<int>()),
+                subtask["status"].get<std::string>(),
+                int64_t(subtask["time_taken"].get<int>()),
+                int64_t(subtask["memory_taken"].get<int>())
+            });
+        }
+    }
+    size_t changed = 0;
+    try {
+        api.beginTransaction();
+        std::unique_ptr<PooledStatement> pstmt(api.prepareStatement("UPDATE problem_submissions SET status = ?, score = ?, time_taken = ?, memory_taken = ? WHERE id = ?;"));
+        for (const auto& [submission_id, result] : batch) {
+            pstmt->setString(1, result["status"].get<std::string>());
+            pstmt->setInt(2, result["score"].get<int>());
+            pstmt->setInt(3, result["time_taken"].get<int>());
+            pstmt->setInt(4, result["memory_taken"].get<int>());
+            pstmt->setInt64(5, submission_id);
+            pstmt->execute();
+        }
+        // the old test case results are replaced, not added to
+        pstmt = api.prepareStatement("DELETE FROM problem_submissions_subtasks WHERE submission_id IN (" + APIs::inPlaceholders(batch.size()) + ");");
+        for (size_t i = 0; i < batch.size(); i++) {
+            pstmt->setInt64(i + 1, batch[i].first);
+        }
+        pstmt->execute();
+        pstmt.reset();
+        api.insertBatch("problem_submissions_subtasks", {"submission_id", "test_case_id", "status", "time_taken", "memory_taken"}, subtasks);
+        api.commitTransaction();
+    } catch (const std::exception& e) {
+        api.rollbackTransaction();
+        std::cerr << "Writing " << batch.size() << " rejudged verdicts failed: " << e.what() << std::endl;
+        std::lock_guard<std::mutex> lock(mtx);
+        task->progress.failed += batch.size();
+        for (const auto& entry : batch) {
+            task->old_status.erase(entry.first);
+        }
+        return;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    for (const auto& [submission_id, result] : batch) {
+        auto old = task->old_status.find(submission_id);
+        if (old != task->old_status.end()) {
+            changed += old->second != result["status"].get<std::string>();
+            task->old_status.erase(old);
+        }
+    }
+    task->progress.judged += batch.size();
+    task->progress.changed += changed;
+}
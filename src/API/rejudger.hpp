@@ -0,0 +1,144 @@
+/**
+ * @file rejudger.hpp
+ * @brief Header file for the Rejudger class.
+ */
+
+#pragma once
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <utility>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "api.hpp"
+#include "judge_queue.hpp"
+
+/**
+ * @class Rejudger
+ * @brief Rejudges every submission of a problem in the background, e.g. after its test cases were fixed.
+ *
+ * One background thread runs the rejudge tasks one after another. It reads the submissions of a
+ * problem in chunks by id and queues them on the JudgeQueue in the rejudge class, at no more than
+ * rate_per_second and with at most max_outstanding of them queued or being judged at once, so live
+ * submissions keep the judges. A submission keeps its old verdict until the new one is written;
+ * the new verdicts and test case results are written batch_size at a time in one transaction.
+ * Tasks live in memory only; a task interrupted by a restart has to be started again.
+ */
+class Rejudger {
+public:
+    /**
+     * @struct Config
+     * @brief Throttling and batching of the rejudge tasks.
+     */
+    struct Config {
+        size_t chunk_size = 200; /**< Submissions read per query. */
+        double rate_per_second = 20; /**< The most submissions queued per second. */
+        size_t max_outstanding = 8; /**< The most submissions of the task queued or being judged at once. */
+        size_t batch_size = 50; /**< Verdicts written per transaction. */
+        std::chrono::milliseconds flush_interval{1000}; /**< The longest a verdict waits to be written. */
+    };
+
+    /**
+     * @struct Progress
+     * @brief The state of a rejudge task.
+     */
+    struct Progress {
+        uint64_t id;
+        int problem_id;
+        std::string state; /**< "waiting", "running", "done", "cancelled" or "failed". */
+        std::string error; /**< Why the task failed. */
+        size_t total; /**< Submissions of the problem when the task started. */
+        size_t queued; /**< Submissions handed to the judge queue. */
+        size_t judged; /**< Submissions whose new verdict was written. */
+        size_t changed; /**< Judged submissions whose status differs from the old one. */
+        size_t failed; /**< Submissions that could not be judged; they keep their old verdict. */
+        std::chrono::system_clock::time_point started_at;
+    };
+
+    /**
+     * @brief Starts the background thread.
+     * @param api The database the submissions live in.
+     * @param queue The judge queue the submissions are rejudged on.
+     * @param config Throttling and batching.
+     */
+    Rejudger(APIs& api, JudgeQueue& queue, const Config& config);
+
+    /**
+     * @brief Cancels every task and stops the background thread once the submissions in flight are written.
+     */
+    ~Rejudger();
+
+    Rejudger(const Rejudger&) = delete;
+    Rejudger& operator=(const Rejudger&) = delete;
+
+    /**
+     * @brief Queues a task rejudging every submission of a problem.
+     * @return The id of the task.
+     */
+    uint64_t start(int problem_id);
+
+    /**
+     * @brief Cancels the waiting and running tasks of a problem. Submissions already queued are
+     * still judged and written.
+     * @return The number of tasks cancelled.
+     */
+    size_t cancel(int problem_id);
+
+    /**
+     * @brief Returns the progress of the tasks of a problem, newest first.
+     */
+    std::vector<Progress> progress(int problem_id) const;
+
+private:
+    /**
+     * @struct Task
+     * @brief A rejudge task, shared with the callbacks of its queued submissions.
+     */
+    struct Task {
+        Progress progress; /**< Guarded by Rejudger::mtx. */
+        bool cancelled = false; /**< Guarded by Rejudger::mtx. */
+        std::unordered_map<int64_t, std::string> old_status; /**< Status of the outstanding submissions before the rejudge. Guarded by Rejudger::mtx. */
+        std::vector<std::pair<int64_t, nlohmann::json>> results; /**< Verdicts not written yet. Guarded by Rejudger::mtx. */
+        size_t outstanding = 0; /**< Submissions queued and not reported back yet. Guarded by Rejudger::mtx. */
+    };
+
+    /**
+     * @brief The background thread: runs the waiting tasks one after another.
+     */
+    void loop();
+
+    /**
+     * @brief Queues the submissions of a task and writes their verdicts.
+     */
+    void run(const std::shared_ptr<Task>& task);
+
+    /**
+     * @brief Writes the collected verdicts of a task in one transaction.
+     */
+    void flush(const std::shared_ptr<Task>& task);
+
+    /**
+     * @brief Called by a judge worker when a submission of a task was judged, with nullptr if judging failed.
+     */
+    void report(const std::shared_ptr<Task>& task, int64_t submission_id, const nlohmann::json* result);
+
+    APIs& api; /**< The database the submissions live in. */
+    JudgeQueue& queue; /**< The judge queue the submissions are rejudged on. */
+    Config config; /**< Throttling and batching. */
+    mutable std::mutex mtx; /**< Guards the tasks and stopping. */
+    std::condition_variable cv; /**< Signalled when a task is added or cancelled, a result comes back or the rejudger stops. */
+    std::deque<std::shared_ptr<Task>> tasks; /**< Every task kept for progress reports, oldest first. */
+    uint64_t next_id = 1; /**< The id of the next task. */
+    bool stopping = false; /**< Set by the destructor. */
+    std::thread worker; /**< Runs loop(). */
+};
@@ -0,0 +1,65 @@
+/**
+ * @file row_mapper.cpp
+ * @brief Implementation of the RowMapper class.
+ */
+
+#include "row_mapper.hpp"
+
+RowMapper::RowMapper(std::initializer_list<Column> columns) : columns(columns) {
+    for (auto& column : this->columns) {
+        if (column.key.empty()) {
+            column.key = column.name;
+        }
+    }
+}
+
+std::vector<uint32_t> RowMapper::resolve(sql::ResultSet& res) const {
+    std::vector<uint32_t> indexes;
+    indexes.reserve(columns.size());
+    for (const auto& column : columns) {
+        indexes.push_back(res.findColumn(column.name));
+    }
+    return indexes;
+}
+
+void RowMapper::fill(sql::ResultSet& res, const std::vector<uint32_t>& indexes, nlohmann::json& row) const {
+    row = nlohmann::json::object();
+    for (size_t i = 0; i < columns.size(); i++) {
+        nlohmann::json& value = row[columns[i].key];
+        switch (columns[i].type) {
+            case Type::Int:
+                value = res.getInt(indexes[i]);
+                break;
+            case Type::Int64:
+                value = res.getInt64(indexes[i]);
+                break;
+            case Type::String:
+                value = static_cast<std::string>(res.getString(indexes[i]));
+                break;
+            case Type::Json:
+                value = res.isNull(indexes[i]) ? nlohmann::json::array() : nlohmann::json::parse(res.getString(indexes[i]).asStdString());
+                break;
+        }
+    }
+}
+
+nlohmann::json RowMapper::map(sql::ResultSet& res) const {
+    nlohmann::json rows = nlohmann::json::array();
+    if (!res.next()) {
+        return rows;
+    }
+    std::vector<uint32_t> indexes = resolve(res);
+    rows.get_ref<nlohmann::json::array_t&>().reserve(res.rowsCount());
+    do {
+        fill(res, indexes, rows.emplace_back());
+    } while (res.next());
+    return rows;
+}
+
+bool RowMapper::mapNext(sql::ResultSet& res, nlohmann::json& row) const {
+    if (!res.next()) {
+        return false;
+    }
+    fill(res, resolve(res), row);
+    return true;
+}
@@ -0,0 +1,78 @@
+/**
+ * @file row_mapper.hpp
+ * @brief Header file for the RowMapper class.
+ */
+
+#pragma once
+
+#include <cppconn/resultset.h>
+#include <nlohmann/json.hpp>
+
+#include <initializer_list>
+#include <string>
+#include <vector>
+
+/**
+ * @class RowMapper
+ * @brief Maps result set rows straight into JSON objects.
+ *
+ * A loader declares its columns once, usually as a function-local static. map() resolves the
+ * column indexes once per result set instead of looking every column up by name on every row,
+ * reserves the output array and builds each row in place, so large TEXT columns are copied once
+ * from the driver and never again.
+ */
+class RowMapper {
+public:
+    /**
+     * @brief How a column is read and stored.
+     */
+    enum class Type {
+        Int,    /**< getInt(); NULL reads as 0. */
+        Int64,  /**< getInt64(); NULL reads as 0. */
+        String, /**< getString(); NULL reads as "". */
+        Json    /**< A JSON document, e.g. from JSON_ARRAYAGG; NULL reads as []. */
+    };
+
+    /**
+     * @struct Column
+     * @brief A column of the result set and the key it is stored under.
+     */
+    struct Column {
+        std::string name; /**< The column name or alias in the SELECT list. */
+        Type type; /**< How the column is read. */
+        std::string key; /**< The JSON key; empty to use name. */
+    };
+
+    /**
+     * @brief Declares the mapped columns.
+     */
+    RowMapper(std::initializer_list<Column> columns);
+
+    /**
+     * @brief Maps every remaining row of the result set into a JSON array.
+     * @param res The result set, positioned before its first unread row.
+     * @return The array of row objects, empty if there are no rows.
+     */
+    nlohmann::json map(sql::ResultSet& res) const;
+
+    /**
+     * @brief Advances to the next row and maps it.
+     * @param res The result set.
+     * @param row Filled with the row object.
+     * @return false if there was no next row; row is left untouched.
+     */
+    bool mapNext(sql::ResultSet& res, nlohmann::json& row) const;
+
+private:
+    /**
+     * @brief Returns the 1-based index of each column in the result set.
+     */
+    std::vector<uint32_t> resolve(sql::ResultSet& res) const;
+
+    /**
+     * @brief Builds the object of the current row into `row`.
+     */
+    void fill(sql::ResultSet& res, const std::vector<uint32_t>& indexes, nlohmann::json& row) const;
+
+    std::vector<Column> columns; /**< The mapped columns, with key filled in. */
+};
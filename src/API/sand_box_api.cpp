@@ -0,0 +1,203 @@
+/**
+ * @file sand_box_api.cpp
+ * @brief Implementation of the sand_box_api class.
+ */
+
+#include "sand_box_api.hpp"
+#include "../Programs/gzip.hpp"
+
+#include <algorithm>
+#include <stdexcept>
+
+namespace {
+std::once_flag curl_initialized;
+}
+
+size_t sand_box_api::WriteCallback(void *contents, size_t size, size_t nmemb, Transfer *transfer) {
+    size_t newLength = size * nmemb;
+    try {
+        bool first = transfer->response.empty();
+        transfer->response.append(static_cast<char*>(contents), newLength);
+        if (transfer->on_data) {
+            transfer->on_data(std::string_view(static_cast<char*>(contents), newLength), first);
+        }
+    } catch (std::exception &e) {
+        // Handle memory problem or a failing callback; aborts the transfer
+        return 0;
+    }
+    return newLength;
+}
+
+sand_box_api::sand_box_api(const std::string& url, int port, const std::string& token, const Options& defaults, long max_connections)
+    : full_url(url + ":" + std::to_string(port)), defaults(defaults) {
+    std::call_once(curl_initialized, [] { curl_global_init(CURL_GLOBAL_DEFAULT); });
+    for (curl_slist** list : {&headers, &gzip_headers}) {
+        *list = curl_slist_append(*list, "Content-Type: application/json");
+        *list = curl_slist_append(*list, ("Authorization: " + token).c_str());
+        // large test case payloads would otherwise wait for a 100-continue round trip
+        *list = curl_slist_append(*list, "Expect:");
+    }
+    gzip_headers = curl_slist_append(gzip_headers, "Content-Encoding: gzip");
+    multi = curl_multi_init();
+    curl_multi_setopt(multi, CURLMOPT_MAX_HOST_CONNECTIONS, max_connections);
+    curl_multi_setopt(multi, CURLMOPT_MAXCONNECTS, max_connections);
+    event_loop = std::thread(&sand_box_api::loop, this);
+}
+
+sand_box_api::~sand_box_api() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    curl_multi_wakeup(multi);
+    event_loop.join();
+    for (CURL* easy : idle_handles) {
+        curl_easy_cleanup(easy);
+    }
+    curl_multi_cleanup(multi);
+    curl_slist_free_all(headers);
+    curl_slist_free_all(gzip_headers);
+}
+
+std::future<std::string> sand_box_api::postAsync(const nlohmann::json& payload, const Options& options, DataCallback on_data) {
+    auto transfer = std::make_unique<Transfer>(in_flight);
+    transfer->body = payload.dump();
+    if (options.compress_min_bytes > 0 && transfer->body.size() >= options.compress_min_bytes) {
+        transfer->body = gzipCompress(transfer->body);
+        transfer->compressed = true;
+    }
+    transfer->options = options;
+    transfer->on_data = std::move(on_data);
+    transfer->due = std::chrono::steady_clock::now();
+    std::future<std::string> result = transfer->result.get_future();
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        if (stopping) {
+            throw std::runtime_error("Sandbox client is shutting down");
+        }
+        queued.push_back(std::move(transfer));
+    }
+    curl_multi_wakeup(multi);
+    return result;
+}
+
+void sand_box_api::start(std::unique_ptr<Transfer> transfer) {
+    CURL* easy;
+    if (idle_handles.empty()) {
+        easy = curl_easy_init();
+    } else {
+        easy = idle_handles.back();
+        idle_handles.pop_back();
+        curl_easy_reset(easy);
+    }
+    transfer->attempt++;
+    transfer->response.clear();
+    curl_easy_setopt(easy, CURLOPT_URL, full_url.c_str());
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDS, transfer->body.c_str());
+    curl_easy_setopt(easy, CURLOPT_POSTFIELDSIZE, static_cast<long>(transfer->body.size()));
+    curl_easy_setopt(easy, CURLOPT_HTTPHEADER, transfer->compressed ? gzip_headers : headers);
+    // accept any response encoding curl can decode
+    curl_easy_setopt(easy, CURLOPT_ACCEPT_ENCODING, "");
+    curl_easy_setopt(easy, CURLOPT_WRITEFUNCTION, WriteCallback);
+    curl_easy_setopt(easy, CURLOPT_WRITEDATA, transfer.get());
+    curl_easy_setopt(easy, CURLOPT_TIMEOUT_MS, static_cast<long>(transfer->options.timeout.count()));
+    curl_easy_setopt(easy, CURLOPT_CONNECTTIMEOUT_MS, static_cast<long>(transfer->options.connect_timeout.count()));
+    curl_easy_setopt(easy, CURLOPT_TCP_KEEPALIVE, 1L);
+    curl_easy_setopt(easy, CURLOPT_NOSIGNAL, 1L);
+    // the multi handle owns the transfer until finish() takes it back
+    curl_easy_setopt(easy, CURLOPT_PRIVATE, transfer.release());
+    curl_multi_add_handle(multi, easy);
+    active.push_back(easy);
+}
+
+void sand_box_api::finish(CURL* easy, CURLcode code) {
+    Transfer* raw = nullptr;
+    curl_easy_getinfo(easy, CURLINFO_PRIVATE, &raw);
+    std::unique_ptr<Transfer> transfer(raw);
+    long status = 0;
+    curl_easy_getinfo(easy, CURLINFO_RESPONSE_CODE, &status);
+    curl_multi_remove_handle(multi, easy);
+    active.erase(std::find(active.begin(), active.end(), easy));
+    idle_handles.push_back(easy);
+
+    if (code == CURLE_OK && status >= 200 && status < 300) {
+        transfer->result.set_value(std::move(transfer->response));
+        return;
+    }
+    bool retryable = code != CURLE_OK || status >= 500;
+    if (retryable && transfer->attempt <= transfer->options.retries) {
+        transfer->due = std::chrono::steady_clock::now() + transfer->options.retry_backoff * (1 << (transfer->attempt - 1));
+        std::lock_guard<std::mutex> lock(mtx);
+        queued.push_back(std::move(transfer));
+        return;
+    }
+    std::string error = code != CURLE_OK
+        ? std::string("Sandbox request failed: ") + curl_easy_strerror(code)
+        : "Sandbox answered with status " + std::to_string(status);
+    transfer->result.set_exception(std::make_exception_ptr(RequestFailed(error, retryable)));
+}
+
+void sand_box_api::loop() {
+    std::vector<std::unique_ptr<Transfer>> due;
+    while (true) {
+        // start the transfers that are due
+        auto now = std::chrono::steady_clock::now();
+        bool stop;
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            stop = stopping;
+            for (auto it = queued.begin(); it != queued.end();) {
+                if (stop || (*it)->due <= now) {
+                    due.push_back(std::move(*it));
+                    it = queued.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        if (stop) {
+            break;
+        }
+        for (auto& transfer : due) {
+            start(std::move(transfer));
+        }
+        due.clear();
+
+        int running = 0;
+        curl_multi_perform(multi, &running);
+        int pending = 0;
+        while (CURLMsg* msg = curl_multi_info_read(multi, &pending)) {
+            if (msg->msg == CURLMSG_DONE) {
+                finish(msg->easy_handle, msg->data.result);
+            }
+        }
+
+        // sleep until a socket is ready, a request is queued or the next retry is due
+        auto next_due = std::chrono::steady_clock::now() + std::chrono::seconds(1);
+        {
+            std::lock_guard<std::mutex> lock(mtx);
+            for (const auto& transfer : queued) {
+                next_due = std::min(next_due, transfer->due);
+            }
+        }
+        int timeout_ms = static_cast<int>(std::max<int64_t>(0, std::chrono::duration_cast<std::chrono::milliseconds>(next_due - std::chrono::steady_clock::now()).count()));
+        curl_multi_poll(multi, nullptr, 0, timeout_ms, nullptr);
+    }
+
+    // fail what is left so no caller waits forever
+    auto abandon = [](Transfer& transfer) {
+        transfer.result.set_exception(std::make_exception_ptr(std::runtime_error("Sandbox client is shutting down")));
+    };
+    for (CURL* easy : active) {
+        Transfer* raw = nullptr;
+        curl_easy_getinfo(easy, CURLINFO_PRIVATE, &raw);
+        std::unique_ptr<Transfer> transfer(raw);
+        curl_multi_remove_handle(multi, easy);
+        idle_handles.push_back(easy);
+        abandon(*transfer);
+    }
+    active.clear();
+    for (auto& transfer : due) {
+        abandon(*transfer);
+    }
+}
@@ -1,61 +1,167 @@
+/**
+ * @file sand_box_api.hpp
+ * @brief Header file for the sand_box_api class.
+ */
+
 #pragma once
 #include <curl/curl.h>
-#include <string>
-#include <iostream>
+#include <atomic>
+#include <chrono>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
 #include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
 #include <nlohmann/json.hpp>
 
+/**
+ * @class sand_box_api
+ * @brief HTTP client of a sandbox node, driven by one curl multi event loop.
+ *
+ * Requests are queued by postAsync() and run concurrently on a single event loop thread, so
+ * callers never wait on each other. The multi handle keeps its connections to the sandbox alive
+ * between requests and easy handles are reused, so a request normally pays neither a TCP
+ * handshake nor the handle setup. Every request has its own timeouts and retry budget.
+ */
 class sand_box_api {
-    std::string full_url;
-    std::string token;
-    std::mutex mtx;
-
-    static size_t WriteCallback(void *contents, size_t size, size_t nmemb, std::string *s) {
-        size_t newLength = size * nmemb;
-        size_t oldLength = s->size();
-        try {
-            s->resize(oldLength + newLength);
-        } catch (std::bad_alloc &e) {
-            // Handle memory problem
-            return 0;
-        }
-        std::copy((char*)contents, (char*)contents + newLength, s->begin() + oldLength);
-        return size * nmemb;
-    }
-
 public:
-    sand_box_api(const std::string& url, int port, const std::string& token) {
-        full_url = url + ":" + std::to_string(port);
-        this->token = token;
-    }
-
-    // Send POST to the sandbox
-    std::string POST(const nlohmann::json& payload) {
-        std::lock_guard<std::mutex> lock(mtx);
-        CURL *curl;
-        CURLcode res;
-        std::string readBuffer;
-        curl = curl_easy_init();
-        if (curl) {
-            struct curl_slist *headers = nullptr;
-            headers = curl_slist_append(headers, "Content-Type: application/json");
-            headers = curl_slist_append(headers, ("Authorization: " + token).c_str());
-
-            curl_easy_setopt(curl, CURLOPT_URL, (full_url).c_str());
-            curl_easy_setopt(curl, CURLOPT_POSTFIELDS, payload.dump().c_str());
-            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers);
-            curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, WriteCallback);
-            curl_easy_setopt(curl, CURLOPT_WRITEDATA, &readBuffer);
-
-            res = curl_easy_perform(curl);
-            if (res != CURLE_OK) {
-                std::cerr << "curl_easy_perform() failed: " << curl_easy_strerror(res) << std::endl;
-                readBuffer = "";
-            }
-
-            curl_slist_free_all(headers);
-            curl_easy_cleanup(curl);
-        }
-        return readBuffer;
-    }
-};
\ No newline at end of file
+    /**
+     * @class RequestFailed
+     * @brief The error a request's future holds once it gives up.
+     */
+    class RequestFailed : public std::runtime_error {
+    public:
+        RequestFailed(const std::string& what, bool node_failure) : std::runtime_error(what), node_failure(node_failure) {}
+
+        /**
+         * @brief True for a transport error or a 5xx answer, false if the node rejected the request itself (4xx).
+         */
+        bool nodeFailure() const { return node_failure; }
+
+    private:
+        bool node_failure;
+    };
+
+    /**
+     * @struct Options
+     * @brief Timeouts and retries of one request.
+     */
+    struct Options {
+        std::chrono::milliseconds timeout{60000}; /**< Whole request, including the judge run. */
+        std::chrono::milliseconds connect_timeout{3000}; /**< TCP connect. */
+        int retries = 1; /**< Extra attempts after a transport error or a 5xx answer. */
+        std::chrono::milliseconds retry_backoff{200}; /**< Delay before the first retry, doubled for each further one. */
+        size_t compress_min_bytes = 0; /**< Bodies at least this large are sent gzip-compressed; 0 never compresses. */
+    };
+
+    /**
+     * @brief Called on the event loop thread with each piece of the response body as it arrives.
+     * `first` is set on the first piece of every attempt, since a retried request delivers its
+     * body again from the start.
+     */
+    using DataCallback = std::function<void(std::string_view chunk, bool first)>;
+
+    /**
+     * @brief Starts the event loop of a sandbox client.
+     * @param url The scheme and host of the sandbox, e.g. "http://judge1".
+     * @param port The port of the sandbox.
+     * @param token Sent as the Authorization header.
+     * @param defaults The options of requests that do not pass their own.
+     * @param max_connections Upper bound of connections kept open to the sandbox.
+     */
+    sand_box_api(const std::string& url, int port, const std::string& token, const Options& defaults, long max_connections = 16);
+
+    /**
+     * @brief Fails the requests still in flight and stops the event loop.
+     */
+    ~sand_box_api();
+
+    sand_box_api(const sand_box_api&) = delete;
+    sand_box_api& operator=(const sand_box_api&) = delete;
+
+    /**
+     * @brief Queues a POST of `payload` to the sandbox.
+     * @param payload The JSON body.
+     * @param options Timeouts and retries of this request.
+     * @param on_data Optionally sees the response body while it streams in, e.g. per test case verdicts.
+     * @return A future holding the response body, or a RequestFailed once the retries are
+     * used up or the sandbox answered with a 4xx status.
+     */
+    std::future<std::string> postAsync(const nlohmann::json& payload, const Options& options, DataCallback on_data = nullptr);
+
+    /**
+     * @brief Queues a POST of `payload` with the default options.
+     */
+    std::future<std::string> postAsync(const nlohmann::json& payload) { return postAsync(payload, defaults); }
+
+    /**
+     * @brief Sends a POST and waits for its response.
+     * @return The response body.
+     * @throws std::runtime_error as described for postAsync().
+     */
+    std::string POST(const nlohmann::json& payload) { return postAsync(payload).get(); }
+
+    /**
+     * @brief Returns the number of requests queued or in flight.
+     */
+    size_t inFlight() const { return in_flight.load(); }
+
+private:
+    /**
+     * @struct Transfer
+     * @brief A request and its state across attempts.
+     */
+    struct Transfer {
+        /**
+         * @brief Counts the transfer in `in_flight` until it is destroyed, whichever way it ends.
+         */
+        explicit Transfer(std::atomic<size_t>& in_flight) : in_flight(in_flight) { in_flight++; }
+        ~Transfer() { in_flight--; }
+        Transfer(const Transfer&) = delete;
+        Transfer& operator=(const Transfer&) = delete;
+
+        std::atomic<size_t>& in_flight; /**< The client's count of requests queued or in flight. */
+        std::string body; /**< The request body; curl reads it in place. */
+        bool compressed = false; /**< Whether body is gzip-compressed. */
+        std::string response; /**< The response body of the current attempt. */
+        Options options; /**< Timeouts and retries. */
+        int attempt = 0; /**< Attempts made so far. */
+        std::chrono::steady_clock::time_point due; /**< When the next attempt may start. */
+        std::promise<std::string> result; /**< Fulfilled when the request succeeds or gives up. */
+        DataCallback on_data; /**< Sees the response body as it arrives, if set. */
+    };
+
+    static size_t WriteCallback(void *contents, size_t size, size_t nmemb, Transfer *transfer);
+
+    /**
+     * @brief The event loop: starts due transfers, drives the multi handle and completes transfers.
+     */
+    void loop();
+
+    /**
+     * @brief Starts the next attempt of a transfer on a pooled easy handle.
+     */
+    void start(std::unique_ptr<Transfer> transfer);
+
+    /**
+     * @brief Handles a finished attempt: completes the transfer, or schedules its retry.
+     */
+    void finish(CURL* easy, CURLcode code);
+
+    std::string full_url; /**< The URL requests are sent to. */
+    Options defaults; /**< The options of requests that do not pass their own. */
+    curl_slist* headers = nullptr; /**< The headers shared by every request. */
+    curl_slist* gzip_headers = nullptr; /**< headers plus "Content-Encoding: gzip", for compressed bodies. */
+    CURLM* multi; /**< The multi handle owning the live connections. */
+    std::vector<CURL*> idle_handles; /**< Easy handles ready for reuse. Only touched by the event loop. */
+    std::vector<CURL*> active; /**< Easy handles attached to the multi handle. Only touched by the event loop. */
+    std::mutex mtx; /**< Guards queued and stopping. */
+    std::deque<std::unique_ptr<Transfer>> queued; /**< Transfers waiting for their next attempt. */
+    bool stopping = false; /**< Set by the destructor. */
+    std::atomic<size_t> in_flight{0}; /**< Requests queued or in flight. */
+    std::thread event_loop; /**< Runs loop(). */
+};
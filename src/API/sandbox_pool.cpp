@@ -0,0 +1,190 @@
+/**
+ * @file sandbox_pool.cpp
+ * @brief Implementation of the SandboxPool class.
+ */
+
+#include "sandbox_pool.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+
+SandboxPool::SandboxPool(const std::vector<NodeConfig>& nodes, const Config& config) : config(config) {
+    if (nodes.empty()) {
+        throw std::invalid_argument("At least one sandbox node is required");
+    }
+    auto now = std::chrono::steady_clock::now();
+    this->nodes.resize(nodes.size());
+    for (size_t i = 0; i < nodes.size(); i++) {
+        Node& node = this->nodes[i];
+        node.config = nodes[i];
+        node.url = nodes[i].host + ":" + std::to_string(nodes[i].port);
+        node.client = std::make_unique<sand_box_api>(nodes[i].host, nodes[i].port, nodes[i].token, config.request, nodes[i].max_connections);
+        node.warming_since = now;
+    }
+    prober = std::thread(&SandboxPool::probeLoop, this);
+}
+
+SandboxPool::~SandboxPool() {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        stopping = true;
+    }
+    prober_cv.notify_all();
+    slot_freed.notify_all();
+    prober.join();
+}
+
+double SandboxPool::ramp(const Node& node, std::chrono::steady_clock::time_point now) const {
+    if (config.slow_start.count() <= 0) {
+        return 1;
+    }
+    double elapsed = std::chrono::duration<double>(now - node.warming_since).count() / std::chrono::duration<double>(config.slow_start).count();
+    return std::clamp(elapsed, 0.1, 1.0);
+}
+
+int SandboxPool::acquire(const std::vector<bool>& tried) {
+    std::unique_lock<std::mutex> lock(mtx);
+    while (true) {
+        auto now = std::chrono::steady_clock::now();
+        int best = -1;
+        double best_load = 0;
+        bool any_healthy = false;
+        for (size_t i = 0; i < nodes.size(); i++) {
+            const Node& node = nodes[i];
+            if (tried[i] || node.ejected) {
+                continue;
+            }
+            any_healthy = true;
+            double share = ramp(node, now);
+            size_t capacity = std::max<size_t>(1, static_cast<size_t>(node.config.capacity * share));
+            if (node.outstanding >= capacity) {
+                continue;
+            }
+            double load = (node.outstanding + 1) / (node.config.weight * share);
+            if (best == -1 || load < best_load) {
+                best = static_cast<int>(i);
+                best_load = load;
+            }
+        }
+        if (best != -1) {
+            nodes[best].outstanding++;
+            return best;
+        }
+        if (!any_healthy || stopping) {
+            return -1;
+        }
+        slot_freed.wait(lock);
+    }
+}
+
+void SandboxPool::release(size_t index, bool job, bool ok) {
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        Node& node = nodes[index];
+        auto now = std::chrono::steady_clock::now();
+        if (job) {
+            node.outstanding--;
+            ok ? node.completed++ : node.failed++;
+        }
+        if (ok) {
+            node.consecutive_failures = 0;
+            if (node.ejected && now >= node.ejected_until) {
+                // back from an ejection: start taking jobs again, slowly
+                std::cerr << "Sandbox node " << node.url << " recovered" << std::endl;
+                node.ejected = false;
+                node.warming_since = now;
+            }
+        } else if (++node.consecutive_failures >= config.eject_after_failures) {
+            if (!node.ejected) {
+                std::cerr << "Sandbox node " << node.url << " ejected after " << node.consecutive_failures << " failures" << std::endl;
+            }
+            node.ejected = true;
+            node.ejected_until = now + config.eject_time;
+        }
+    }
+    slot_freed.notify_all();
+}
+
+std::string SandboxPool::POST(const nlohmann::json& payload, const std::unordered_map<std::string, std::string>* blobs, const sand_box_api::DataCallback& on_data) {
+    std::vector<bool> tried(nodes.size(), false);
+    std::string lastError = "No healthy sandbox node";
+    while (true) {
+        int index = acquire(tried);
+        if (index == -1) {
+            throw std::runtime_error(lastError);
+        }
+        tried[index] = true;
+        try {
+            std::string response = nodes[index].client->postAsync(payload, config.request, on_data).get();
+            nlohmann::json missing = nlohmann::json::parse(response, nullptr, false);
+            if (blobs && missing.is_object() && missing.contains("missing")) {
+                // upload only what this node lacks, along with the job so it is judged in the same round trip
+                nlohmann::json upload = payload;
+                upload["blobs"] = nlohmann::json::object();
+                for (const auto& hash : missing["missing"]) {
+                    auto blob = blobs->find(hash.get<std::string>());
+                    if (blob == blobs->end()) {
+                        throw std::runtime_error("Sandbox asked for an unknown blob " + hash.get<std::string>());
+                    }
+                    upload["blobs"][blob->first] = blob->second;
+                }
+                response = nodes[index].client->postAsync(upload, config.request, on_data).get();
+                missing = nlohmann::json::parse(response, nullptr, false);
+                if (missing.is_object() && missing.contains("missing")) {
+                    throw std::runtime_error("Sandbox still misses blobs after the upload");
+                }
+            }
+            release(index, true, true);
+            return response;
+        } catch (const sand_box_api::RequestFailed& e) {
+            if (!e.nodeFailure()) {
+                // the node is fine, the job is not; another node would reject it too
+                release(index, true, true);
+                throw;
+            }
+            release(index, true, false);
+            lastError = e.what();
+        } catch (const std::exception& e) {
+            release(index, true, true);
+            throw;
+        }
+    }
+}
+
+void SandboxPool::probeLoop() {
+    sand_box_api::Options probe;
+    probe.timeout = config.probe_timeout;
+    probe.connect_timeout = config.probe_timeout;
+    probe.retries = 0;
+    std::unique_lock<std::mutex> lock(mtx);
+    while (!prober_cv.wait_for(lock, config.probe_interval, [this] { return stopping; })) {
+        lock.unlock();
+        // the same "hi" the sandbox answers as a connectivity check
+        std::vector<std::future<std::string>> probes;
+        for (auto& node : nodes) {
+            probes.push_back(node.client->postAsync(nlohmann::json("hi"), probe));
+        }
+        for (size_t i = 0; i < probes.size(); i++) {
+            bool ok = true;
+            try {
+                probes[i].get();
+            } catch (const std::exception& e) {
+                ok = false;
+            }
+            release(i, false, ok);
+        }
+        lock.lock();
+    }
+}
+
+std::vector<SandboxPool::NodeStats> SandboxPool::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto now = std::chrono::steady_clock::now();
+    std::vector<NodeStats> result;
+    for (const auto& node : nodes) {
+        result.push_back({node.url, node.config.weight * ramp(node, now), node.config.capacity, node.outstanding,
+                          node.ejected, node.consecutive_failures, node.completed, node.failed});
+    }
+    return result;
+}
@@ -0,0 +1,163 @@
+/**
+ * @file sandbox_pool.hpp
+ * @brief Header file for the SandboxPool class.
+ */
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+#include "sand_box_api.hpp"
+
+/**
+ * @class SandboxPool
+ * @brief Spreads judge jobs over several sandbox nodes.
+ *
+ * Every job goes to the node with the fewest outstanding jobs relative to its weight, skipping
+ * nodes that are at capacity. A node that fails `eject_after_failures` requests or health probes
+ * in a row is ejected; a background thread probes every node each `probe_interval`, and the
+ * first successful probe at least `eject_time` after the last failure brings it back. A node
+ * coming back (or added at startup) ramps its weight and capacity up over `slow_start` so a cold
+ * judge is not flooded.
+ */
+class SandboxPool {
+public:
+    /**
+     * @struct NodeConfig
+     * @brief A sandbox node and its share of the load.
+     */
+    struct NodeConfig {
+        std::string host; /**< The scheme and host of the node. */
+        int port; /**< The port of the node. */
+        std::string token; /**< Sent as the Authorization header. */
+        double weight = 1; /**< Relative share of the jobs. */
+        size_t capacity = 4; /**< Jobs the node runs at once. */
+        long max_connections = 16; /**< Keep-alive connections held open to the node. */
+    };
+
+    /**
+     * @struct Config
+     * @brief Health checking of the pool.
+     */
+    struct Config {
+        sand_box_api::Options request; /**< Timeouts and retries of a job. */
+        std::chrono::milliseconds probe_interval{5000}; /**< Time between two health probes of a node. */
+        std::chrono::milliseconds probe_timeout{2000}; /**< Timeout of a health probe. */
+        int eject_after_failures = 3; /**< Consecutive failures that eject a node. */
+        std::chrono::milliseconds eject_time{30000}; /**< How long an ejected node gets no jobs. */
+        std::chrono::milliseconds slow_start{30000}; /**< Ramp-up time of a node after it joins or recovers. */
+    };
+
+    /**
+     * @struct NodeStats
+     * @brief The state of one node.
+     */
+    struct NodeStats {
+        std::string url;
+        double weight;
+        size_t capacity;
+        size_t outstanding;
+        bool ejected;
+        int consecutive_failures;
+        uint64_t completed;
+        uint64_t failed;
+    };
+
+    /**
+     * @brief Connects to the nodes and starts the health prober.
+     */
+    SandboxPool(const std::vector<NodeConfig>& nodes, const Config& config);
+
+    /**
+     * @brief Stops the health prober.
+     */
+    ~SandboxPool();
+
+    SandboxPool(const SandboxPool&) = delete;
+    SandboxPool& operator=(const SandboxPool&) = delete;
+
+    /**
+     * @brief Sends a job to the least-loaded healthy node and waits for its answer.
+     *
+     * Waits for a free slot while every healthy node is at capacity. If the chosen node fails with
+     * a transport error or a 5xx answer, the job is tried once on each other healthy node. A 4xx
+     * answer or a malformed exchange is the job's fault: it is thrown to the caller at once and
+     * does not count against the node.
+     *
+     * If the node answers {"missing": [hash, ...]} because it does not hold some of the test case
+     * inputs or outputs the job refers to, the job is sent again to the same node with those
+     * contents in "blobs", keyed by their hash.
+     *
+     * @param payload The job.
+     * @param blobs The contents the job refers to by hash, or nullptr if it refers to none.
+     * @param on_data Optionally sees the response body while it streams in. It also sees the
+     *                bodies of failed attempts and of the "missing" answer.
+     * @return The response body.
+     * @throws std::runtime_error if no node is healthy or every attempt failed.
+     */
+    std::string POST(const nlohmann::json& payload, const std::unordered_map<std::string, std::string>* blobs = nullptr, const sand_box_api::DataCallback& on_data = nullptr);
+
+    /**
+     * @brief Returns the state of every node.
+     */
+    std::vector<NodeStats> stats() const;
+
+private:
+    /**
+     * @struct Node
+     * @brief A node, its client and its health.
+     */
+    struct Node {
+        NodeConfig config;
+        std::string url;
+        std::unique_ptr<sand_box_api> client;
+        size_t outstanding = 0; /**< Jobs sent and not answered yet. */
+        int consecutive_failures = 0; /**< Failed requests or probes since the last success. */
+        bool ejected = false; /**< Set after repeated failures; cleared by a success after ejected_until. */
+        std::chrono::steady_clock::time_point ejected_until; /**< Earliest time an ejected node may come back. */
+        std::chrono::steady_clock::time_point warming_since; /**< Start of the current slow start. */
+        uint64_t completed = 0; /**< Jobs answered. */
+        uint64_t failed = 0; /**< Jobs that failed on this node. */
+    };
+
+    /**
+     * @brief Returns the share of its weight and capacity a node gets during slow start, in (0, 1].
+     */
+    double ramp(const Node& node, std::chrono::steady_clock::time_point now) const;
+
+    /**
+     * @brief Picks the least-loaded healthy node with a free slot and counts the job on it.
+     * @param tried Nodes that already failed this job.
+     * @return The node index, or -1 if no healthy node is left to try.
+     */
+    int acquire(const std::vector<bool>& tried);
+
+    /**
+     * @brief Counts the end of a job or probe on a node, ejecting it after repeated failures.
+     */
+    void release(size_t index, bool job, bool ok);
+
+    /**
+     * @brief Periodically probes every node.
+     */
+    void probeLoop();
+
+    Config config; /**< Health checking of the pool. */
+    std::vector<Node> nodes; /**< The nodes. */
+    mutable std::mutex mtx; /**< Guards the state of the nodes and stopping. */
+    std::condition_variable slot_freed; /**< Signalled when a job ends or a node changes state. */
+    std::condition_variable prober_cv; /**< Wakes the prober on shutdown. */
+    bool stopping = false; /**< Set by the destructor. */
+    std::thread prober; /**< Runs probeLoop(). */
+};
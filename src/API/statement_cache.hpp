@@ -0,0 +1,78 @@
+/**
+ * @file statement_cache.hpp
+ * @brief Header file for the StatementCache class.
+ */
+
+#pragma once
+
+#include <cppconn/prepared_statement.h>
+
+#include <list>
+#include <memory>
+#include <string>
+#include <unordered_map>
+
+/**
+ * @class StatementCache
+ * @brief An LRU cache of prepared statements belonging to one connection, keyed by SQL text.
+ *
+ * A statement is taken out of the cache while it is in use and put back when its user is done
+ * with it, so the same statement is never handed out twice at once. The cache is owned by a
+ * PooledConnection and only touched by the thread that checked the connection out, so it is not
+ * synchronized.
+ */
+class StatementCache {
+private:
+    typedef std::pair<std::string, std::unique_ptr<sql::PreparedStatement>> entry_t;
+
+    size_t capacity; /**< Maximum number of cached statements; 0 disables caching. */
+    std::list<entry_t> items; /**< Cached statements, most recently used at the front. */
+    std::unordered_map<std::string, std::list<entry_t>::iterator> index; /**< SQL text to position in items. */
+
+public:
+    /**
+     * @brief Constructs a cache holding up to `capacity` statements.
+     */
+    explicit StatementCache(size_t capacity = 0) : capacity(capacity) {}
+
+    /**
+     * @brief Removes the statement prepared for `query` from the cache and returns it.
+     * @return The cached statement with its parameters cleared, or nullptr on a miss.
+     */
+    std::unique_ptr<sql::PreparedStatement> take(const std::string& query) {
+        auto it = index.find(query);
+        if (it == index.end()) {
+            return nullptr;
+        }
+        std::unique_ptr<sql::PreparedStatement> statement = std::move(it->second->second);
+        items.erase(it->second);
+        index.erase(it);
+        statement->clearParameters();
+        return statement;
+    }
+
+    /**
+     * @brief Puts a statement back, evicting the least recently used one if the cache is full.
+     *
+     * If a statement for the same query is already cached (it was prepared twice because the first
+     * one was in use), the incoming one is dropped.
+     */
+    void put(const std::string& query, std::unique_ptr<sql::PreparedStatement> statement) {
+        if (capacity == 0 || index.count(query)) {
+            return;
+        }
+        items.emplace_front(query, std::move(statement));
+        index[query] = items.begin();
+        if (items.size() > capacity) {
+            index.erase(items.back().first);
+            items.pop_back();
+        }
+    }
+
+    /**
+     * @brief Returns the number of cached statements.
+     */
+    size_t size() const {
+        return items.size();
+    }
+};
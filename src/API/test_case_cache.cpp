@@ -0,0 +1,128 @@
+/**
+ * @file test_case_cache.cpp
+ * @brief Implementation of the TestCaseCache class.
+ */
+#include "test_case_cache.hpp"
+#include "../Programs/hash_SHA256.hpp"
+
+TestCaseCache::TestCaseCache(size_t max_bytes) : max_bytes(max_bytes) {}
+
+void TestCaseCache::setMaxBytes(size_t max_bytes) {
+    std::lock_guard<std::mutex> lock(mtx);
+    this->max_bytes = max_bytes;
+    evict();
+}
+
+std::shared_ptr<const TestCaseCache::Bundle> TestCaseCache::get(int problem_id, const std::function<nlohmann::json()>& load) {
+    uint64_t loadVersion;
+    std::promise<std::shared_ptr<const Bundle>> promise;
+    std::unique_lock<std::mutex> lookup(mtx);
+    auto it = entries.find(problem_id);
+    if (it != entries.end()) {
+        recency.splice(recency.begin(), recency, it->second.recency);
+        hits++;
+        return it->second.bundle;
+    }
+    loadVersion = versionOf(problem_id);
+    auto running = loading.find(problem_id);
+    if (running != loading.end() && running->second.version == loadVersion) {
+        // someone is already loading this version; wait for their result
+        std::shared_future<std::shared_ptr<const Bundle>> result = running->second.result;
+        lookup.unlock();
+        coalesced++;
+        return result.get();
+    }
+    // a flight of an older version is superseded; it finds itself replaced when it finishes
+    loading[problem_id] = {loadVersion, promise.get_future().share()};
+    lookup.unlock();
+    misses++;
+    std::shared_ptr<Bundle> bundle;
+    try {
+        bundle = build(problem_id, loadVersion, load());
+    } catch (...) {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto flight = loading.find(problem_id);
+        if (flight != loading.end() && flight->second.version == loadVersion) {
+            loading.erase(flight);
+        }
+        promise.set_exception(std::current_exception());
+        throw;
+    }
+    promise.set_value(bundle);
+
+    std::lock_guard<std::mutex> lock(mtx);
+    auto flight = loading.find(problem_id);
+    if (flight != loading.end() && flight->second.version == loadVersion) {
+        loading.erase(flight);
+    }
+    // an invalidate() during the load means the bundle may already be stale
+    if (versionOf(problem_id) != loadVersion || bundle->bytes > max_bytes || entries.count(problem_id)) {
+        return bundle;
+    }
+    recency.push_front(problem_id);
+    entries[problem_id] = {bundle, recency.begin()};
+    bytes += bundle->bytes;
+    evict();
+    return bundle;
+}
+
+std::shared_ptr<TestCaseCache::Bundle> TestCaseCache::build(int problem_id, uint64_t version, nlohmann::json problem) {
+    auto bundle = std::make_shared<Bundle>();
+    bundle->problem_id = problem_id;
+    bundle->version = version;
+    bundle->test_cases = nlohmann::json::array();
+    bundle->bytes = 0;
+    bundle->mode = problem.value("mode", "all");
+    bundle->chunk_size = problem.value("chunk_size", size_t(0));
+    for (auto& test_case : problem["test_cases"]) {
+        nlohmann::json reference = {{"id", test_case["id"]}, {"ti", test_case["ti"]}, {"me", test_case["me"]}};
+        bundle->scores[test_case["id"].get<int>()] = test_case.value("sc", 0);
+        for (const char* field : {"in", "ou"}) {
+            std::string& content = test_case[field].get_ref<std::string&>();
+            std::string hash = sha256(content);
+            if (!bundle->blobs.count(hash)) {
+                bundle->bytes += content.size();
+                bundle->blobs.emplace(hash, std::move(content));
+            }
+            reference[std::string(field) + "_hash"] = std::move(hash);
+        }
+        bundle->test_cases.push_back(std::move(reference));
+    }
+    return bundle;
+}
+
+void TestCaseCache::invalidate(int problem_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    versions[problem_id] = ++clock;
+    auto it = entries.find(problem_id);
+    if (it != entries.end()) {
+        bytes -= it->second.bundle->bytes;
+        recency.erase(it->second.recency);
+        entries.erase(it);
+    }
+}
+
+uint64_t TestCaseCache::version(int problem_id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return versionOf(problem_id);
+}
+
+TestCaseCache::Stats TestCaseCache::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {hits.load(), misses.load(), coalesced.load(), evictions.load(), entries.size(), bytes, max_bytes};
+}
+
+uint64_t TestCaseCache::versionOf(int problem_id) const {
+    auto it = versions.find(problem_id);
+    return it == versions.end() ? 0 : it->second;
+}
+
+void TestCaseCache::evict() {
+    while (bytes > max_bytes && !recency.empty()) {
+        auto it = entries.find(recency.back());
+        bytes -= it->second.bundle->bytes;
+        entries.erase(it);
+        recency.pop_back();
+        evictions++;
+    }
+}
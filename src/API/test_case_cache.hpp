@@ -0,0 +1,150 @@
+/**
+ * @file test_case_cache.hpp
+ * @brief In-process cache of the test cases of each problem, in the sandbox payload format.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <future>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * @class TestCaseCache
+ * @brief Keeps the test case bundle of recently judged problems, bounded by their total size.
+ *
+ * A bundle also carries the judging settings of the problem, so changing those invalidates it too.
+ *
+ * Every problem has a version that invalidate() moves forward; a bundle is only stored if the
+ * version did not change while it was loaded, so a judge worker racing a test case update never
+ * caches the old test cases. This relies on the load reading the primary: a replica may still
+ * serve the old rows after invalidate(), and they would be cached under the new version. The least recently used bundles are evicted once the summed size of
+ * the inputs and outputs exceeds the byte limit.
+ *
+ * Concurrent misses on the same problem and version share one load: the first caller runs it and
+ * the others wait for its result, so a cold start or an invalidate() does not make every judge
+ * worker read the same test cases at once.
+ *
+ * Inputs and outputs are content-addressed: a bundle refers to them by their SHA-256 and keeps
+ * the contents in `blobs`, so the sandbox only has to be sent the ones it has not seen yet.
+ */
+class TestCaseCache {
+public:
+    /**
+     * @struct Bundle
+     * @brief The test cases of a problem at one version. Shared with the workers judging against it.
+     */
+    struct Bundle {
+        int problem_id;
+        uint64_t version; /**< Changes whenever the test cases of the problem change. */
+        nlohmann::json test_cases; /**< Array of {id, in_hash, ou_hash, ti, me}, as sent to the sandbox. */
+        std::unordered_map<int, int> scores; /**< Score of each test case by id, awarded when it is Accepted. Not sent to the sandbox. */
+        std::unordered_map<std::string, std::string> blobs; /**< Inputs and outputs by their SHA-256. */
+        size_t bytes; /**< Summed size of the distinct inputs and outputs. */
+        std::string mode; /**< How the problem is judged: "all" test cases, or until the "first_failure". */
+        size_t chunk_size; /**< Test cases per sandbox request when judging "all"; 0 sends them in one. */
+    };
+
+    /**
+     * @brief Hit, miss and size counters of the cache.
+     */
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t coalesced; /**< Misses that waited for another caller's load instead of running their own. */
+        uint64_t evictions;
+        size_t entries;
+        size_t bytes;
+        size_t max_bytes;
+    };
+
+    /**
+     * @param max_bytes The most input and output bytes kept over all bundles.
+     */
+    explicit TestCaseCache(size_t max_bytes = 256u << 20);
+
+    /**
+     * @brief Changes the byte limit, evicting bundles if the cache is over the new one.
+     */
+    void setMaxBytes(size_t max_bytes);
+
+    /**
+     * @brief Returns the bundle of a problem, loading it on a miss.
+     * @param problem_id The problem.
+     * @param load Reads the problem as {"mode", "chunk_size", "test_cases"}, the test cases being an array of
+     *             {id, in, ou, ti, me, sc} with the inputs and outputs inline, in the order they are
+     *             judged in. It is called without the lock held and may throw; nothing is cached then,
+     *             and the callers waiting for that load get the exception too.
+     */
+    std::shared_ptr<const Bundle> get(int problem_id, const std::function<nlohmann::json()>& load);
+
+    /**
+     * @brief Drops the bundle of a problem and moves its version forward. Call it after
+     * committing a change to the problem's test cases or deleting the problem.
+     */
+    void invalidate(int problem_id);
+
+    /**
+     * @brief Returns the current test case version of a problem, as stored in Bundle::version.
+     */
+    uint64_t version(int problem_id) const;
+
+    /**
+     * @brief Returns the hit, miss and size counters.
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @struct Entry
+     * @brief A cached bundle and its place in the recency list.
+     */
+    struct Entry {
+        std::shared_ptr<const Bundle> bundle;
+        std::list<int>::iterator recency;
+    };
+
+    /**
+     * @struct Flight
+     * @brief A load in progress, shared by the callers that missed on the same problem and version.
+     */
+    struct Flight {
+        uint64_t version;
+        std::shared_future<std::shared_ptr<const Bundle>> result;
+    };
+
+    /**
+     * @brief Turns the loaded problem into a bundle, hashing its inputs and outputs.
+     */
+    static std::shared_ptr<Bundle> build(int problem_id, uint64_t version, nlohmann::json problem);
+
+    /**
+     * @brief Returns the current version of a problem. Requires mtx.
+     */
+    uint64_t versionOf(int problem_id) const;
+
+    /**
+     * @brief Evicts the least recently used bundles until the cache fits max_bytes. Requires mtx.
+     */
+    void evict();
+
+    mutable std::mutex mtx; /**< Guards everything below except the counters. */
+    size_t max_bytes; /**< The most bytes kept over all bundles. */
+    size_t bytes = 0; /**< Bytes kept over all bundles. */
+    std::unordered_map<int, Entry> entries; /**< Cached bundles by problem id. */
+    std::list<int> recency; /**< Problem ids of the cached bundles, most recently used first. */
+    std::unordered_map<int, Flight> loading; /**< Loads in progress by problem id. */
+    std::unordered_map<int, uint64_t> versions; /**< Versions of the problems invalidated since startup; others are at 0. */
+    uint64_t clock = 0; /**< The last version handed out by invalidate(). */
+    std::atomic<uint64_t> hits{0}; /**< Lookups answered from the cache. */
+    std::atomic<uint64_t> misses{0}; /**< Lookups that ran load. */
+    std::atomic<uint64_t> coalesced{0}; /**< Lookups that waited for another lookup's load. */
+    std::atomic<uint64_t> evictions{0}; /**< Bundles dropped to stay under max_bytes. */
+};
@@ -0,0 +1,33 @@
+/**
+ * @file verdict_cache.cpp
+ * @brief Implementation of the VerdictCache class.
+ */
+#include "verdict_cache.hpp"
+#include "../Programs/hash_SHA256.hpp"
+
+VerdictCache::VerdictCache(size_t max_entries) : verdicts(max_entries) {}
+
+std::string VerdictCache::key(int problem_id, uint64_t version, const std::string& language, const std::string& source_code) {
+    // the language cannot contain the unit separator, so the hashed text is unambiguous
+    return std::to_string(problem_id) + ":" + std::to_string(version) + ":" + sha256(language + '\x1f' + source_code);
+}
+
+std::optional<nlohmann::json> VerdictCache::get(const std::string& key) {
+    std::lock_guard<std::mutex> lock(mtx);
+    if (!verdicts.exists(key)) {
+        misses++;
+        return std::nullopt;
+    }
+    hits++;
+    return verdicts.get(key);
+}
+
+void VerdictCache::put(const std::string& key, nlohmann::json verdict) {
+    std::lock_guard<std::mutex> lock(mtx);
+    verdicts.put(key, verdict);
+}
+
+VerdictCache::Stats VerdictCache::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {hits.load(), misses.load(), verdicts.size()};
+}
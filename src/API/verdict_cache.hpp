@@ -0,0 +1,68 @@
+/**
+ * @file verdict_cache.hpp
+ * @brief In-process cache of the verdicts of judged source code.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include <nlohmann/json.hpp>
+
+#include "../include/lrucache.hpp"
+
+/**
+ * @class VerdictCache
+ * @brief Remembers the verdict of each (problem, test case version, language, source code).
+ *
+ * Resubmitting byte-identical code to a problem whose test cases did not change gets the same
+ * verdict, so /submit copies it instead of judging the code again. The test case version is part
+ * of the key, so updating the test cases makes every older entry unreachable; those age out of
+ * the LRU.
+ */
+class VerdictCache {
+public:
+    /**
+     * @brief Hit, miss and size counters of the cache.
+     */
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+    };
+
+    /**
+     * @param max_entries The most verdicts kept.
+     */
+    explicit VerdictCache(size_t max_entries = 65536);
+
+    /**
+     * @brief Builds the key of a submission.
+     * @param version The TestCaseCache version of the problem's test cases.
+     */
+    static std::string key(int problem_id, uint64_t version, const std::string& language, const std::string& source_code);
+
+    /**
+     * @brief Returns the cached verdict: {status, score, time_taken, memory_taken, subtasks}.
+     */
+    std::optional<nlohmann::json> get(const std::string& key);
+
+    /**
+     * @brief Caches a verdict in the form returned by get().
+     */
+    void put(const std::string& key, nlohmann::json verdict);
+
+    /**
+     * @brief Returns the hit, miss and size counters.
+     */
+    Stats stats() const;
+
+private:
+    mutable std::mutex mtx; /**< Held around every use of verdicts, since get() returns a reference. */
+    cache::lru_cache<std::string, nlohmann::json> verdicts; /**< Verdicts by key. */
+    std::atomic<uint64_t> hits{0}; /**< Lookups answered from the cache. */
+    std::atomic<uint64_t> misses{0}; /**< Lookups that found nothing. */
+};
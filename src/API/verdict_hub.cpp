@@ -0,0 +1,94 @@
+/**
+ * @file verdict_hub.cpp
+ * @brief Implementation of the VerdictHub class.
+ */
+
+#include "verdict_hub.hpp"
+
+#include <iostream>
+
+namespace {
+void deliver(const VerdictHub::Listener& listener, const nlohmann::json& event) {
+    try {
+        listener(event);
+    } catch (const std::exception& e) {
+        std::cerr << "Verdict listener failed: " << e.what() << std::endl;
+    }
+}
+}
+
+void VerdictHub::open(int64_t submission_id, int user_id) {
+    std::lock_guard<std::mutex> lock(mtx);
+    submissions[submission_id].user_id = user_id;
+}
+
+void VerdictHub::publish(int64_t submission_id, nlohmann::json event) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = submissions.find(submission_id);
+    if (it == submissions.end()) {
+        return;
+    }
+    event["submission_id"] = submission_id;
+    for (const auto& [subscription, listener] : it->second.listeners) {
+        deliver(listener, event);
+    }
+    it->second.events.push_back(std::move(event));
+    published++;
+}
+
+void VerdictHub::close(int64_t submission_id, nlohmann::json event) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = submissions.find(submission_id);
+    if (it == submissions.end()) {
+        return;
+    }
+    event["submission_id"] = submission_id;
+    for (const auto& [subscription, listener] : it->second.listeners) {
+        deliver(listener, event);
+        subscriptions.erase(subscription);
+    }
+    submissions.erase(it);
+    published++;
+}
+
+std::optional<int> VerdictHub::owner(int64_t submission_id) const {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = submissions.find(submission_id);
+    if (it == submissions.end()) {
+        return std::nullopt;
+    }
+    return it->second.user_id;
+}
+
+std::optional<uint64_t> VerdictHub::subscribe(int64_t submission_id, Listener listener) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = submissions.find(submission_id);
+    if (it == submissions.end()) {
+        return std::nullopt;
+    }
+    for (const auto& event : it->second.events) {
+        deliver(listener, event);
+    }
+    uint64_t subscription = next_subscription++;
+    it->second.listeners.emplace(subscription, std::move(listener));
+    subscriptions.emplace(subscription, submission_id);
+    return subscription;
+}
+
+void VerdictHub::unsubscribe(uint64_t subscription) {
+    std::lock_guard<std::mutex> lock(mtx);
+    auto it = subscriptions.find(subscription);
+    if (it == subscriptions.end()) {
+        return;
+    }
+    auto submission = submissions.find(it->second);
+    if (submission != submissions.end()) {
+        submission->second.listeners.erase(subscription);
+    }
+    subscriptions.erase(it);
+}
+
+VerdictHub::Stats VerdictHub::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {submissions.size(), subscriptions.size(), published};
+}
@@ -0,0 +1,98 @@
+/**
+ * @file verdict_hub.hpp
+ * @brief Header file for the VerdictHub class.
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <unordered_map>
+#include <vector>
+
+#include <nlohmann/json.hpp>
+
+/**
+ * @class VerdictHub
+ * @brief Fans the progress of submissions out from the judge workers to subscribed clients.
+ *
+ * The judge queue opens a submission when it is queued, publishes an event when judging starts
+ * and one per test case as the sandbox reports it, and closes it with the final verdict. A client
+ * subscribing late first gets the events published so far. Once closed, the submission is
+ * forgotten; its result is in the database.
+ */
+class VerdictHub {
+public:
+    /**
+     * @brief Receives the events of a submission. Called with the hub locked, so it must be
+     * quick, e.g. queue a websocket message, and must not call back into the hub.
+     */
+    using Listener = std::function<void(const nlohmann::json& event)>;
+
+    /**
+     * @struct Stats
+     * @brief Size counters of the hub.
+     */
+    struct Stats {
+        size_t submissions; /**< Submissions queued or being judged. */
+        size_t subscribers; /**< Live subscriptions. */
+        uint64_t published; /**< Events published since startup. */
+    };
+
+    /**
+     * @brief Starts tracking a queued submission.
+     */
+    void open(int64_t submission_id, int user_id);
+
+    /**
+     * @brief Sends an event to the subscribers of a submission and keeps it for late ones.
+     * The event gets the submission id added. Does nothing if the submission is not open.
+     */
+    void publish(int64_t submission_id, nlohmann::json event);
+
+    /**
+     * @brief Publishes the final event of a submission and drops it with its subscriptions.
+     */
+    void close(int64_t submission_id, nlohmann::json event);
+
+    /**
+     * @brief Returns the submitter of an open submission.
+     * @return std::nullopt if the submission is not queued or being judged.
+     */
+    std::optional<int> owner(int64_t submission_id) const;
+
+    /**
+     * @brief Subscribes to an open submission; the events published so far are delivered first.
+     * @return The subscription id, or std::nullopt if the submission is not open.
+     */
+    std::optional<uint64_t> subscribe(int64_t submission_id, Listener listener);
+
+    /**
+     * @brief Ends a subscription. Once it returns, the listener is not called anymore.
+     */
+    void unsubscribe(uint64_t subscription);
+
+    /**
+     * @brief Returns the size counters.
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @struct Submission
+     * @brief The events and subscribers of an open submission.
+     */
+    struct Submission {
+        int user_id;
+        std::vector<nlohmann::json> events; /**< Published so far, replayed to late subscribers. */
+        std::unordered_map<uint64_t, Listener> listeners; /**< By subscription id. */
+    };
+
+    mutable std::mutex mtx; /**< Guards everything below. */
+    std::unordered_map<int64_t, Submission> submissions; /**< Open submissions by id. */
+    std::unordered_map<uint64_t, int64_t> subscriptions; /**< Submission id of each live subscription. */
+    uint64_t next_subscription = 1; /**< The id of the next subscription. */
+    uint64_t published = 0; /**< Events published since startup. */
+};
@@ -0,0 +1,46 @@
+/**
+ * @file async_response.hpp
+ * @brief Helpers for completing a Crow response from a DBExecutor or PasswordHasher thread.
+ */
+#pragma once
+
+#include <crow.h>
+#include <functional>
+#include "../API/db_executor.hpp"
+#include "../API/query_stats.hpp"
+
+/**
+ * @brief Completes the response of an asynchronous route from any thread.
+ */
+inline void respondNow(crow::response& res, crow::response value) {
+    res = std::move(value);
+    res.end();
+}
+
+/**
+ * @brief Runs a handler on the database executor and completes the response with its result.
+ *
+ * The Crow worker thread returns as soon as the job is queued, so a slow query only occupies a
+ * database thread. If the executor's queue is full the request is answered with 503 right away.
+ * The QueryStats::Route of the calling thread is carried over to the handler.
+ *
+ * @param executor The executor to run the handler on.
+ * @param res The response of the route, completed with res.end() once the handler returns.
+ * @param handler Builds the response. It must not use the crow::request; copy what it needs first.
+ */
+inline void respondAsync(DBExecutor& executor, crow::response& res, std::function<crow::response()> handler) {
+    bool queued = executor.post([&res, handler = std::move(handler), routeName = QueryStats::currentRoute()] {
+        QueryStats::Route route(routeName);
+        try {
+            res = handler();
+        } catch (const std::exception& e) {
+            CROW_LOG_ERROR << "Exception occurred: " << e.what();
+            res = crow::response(500, R"({"error": "Internal server error"})");
+        }
+        res.end();
+    });
+    if (!queued) {
+        res = crow::response(503, R"({"error": "Server busy, try again later"})");
+        res.end();
+    }
+}
@@ -0,0 +1,31 @@
+#include "auth_middleware.hpp"
+#include "../Programs/jwt.hpp"
+
+void AuthMiddleware::configure(nlohmann::json& settings, const std::string& IP, TokenCache& tokens) {
+    this->settings = &settings;
+    this->IP = IP;
+    this->tokens = &tokens;
+}
+
+void AuthMiddleware::before_handle(crow::request& req, crow::response& res, context& ctx) {
+    std::string jwt = req.get_header_value("Authorization");
+    if (jwt.empty()) {
+        return;
+    }
+    ctx.auth = authenticate(jwt);
+}
+
+AuthContext AuthMiddleware::authenticate(const std::string& jwt) const {
+    if (std::optional<AuthContext> cached = tokens->get(jwt)) {
+        return std::move(*cached);
+    }
+    AuthContext auth;
+    try {
+        auth = JWT::decodeAuth(jwt, *settings, IP);
+        tokens->put(jwt, auth);
+    } catch (const std::exception& e) {
+        auth = AuthContext();
+        auth.error = e.what();
+    }
+    return auth;
+}
@@ -0,0 +1,62 @@
+/**
+ * @file auth_middleware.hpp
+ * @brief Crow middleware decoding the JWT of every request once.
+ */
+#pragma once
+
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <nlohmann/json.hpp>
+#include <string>
+#include "../Programs/auth_context.hpp"
+#include "../Programs/token_cache.hpp"
+
+/**
+ * @struct AuthMiddleware
+ * @brief Verifies and decodes the Authorization header before the route runs.
+ *
+ * Tokens seen before are taken from the TokenCache instead of being verified again.
+ * The route reads the result with `app.get_context<AuthMiddleware>(req).auth` and decides
+ * itself whether an unauthenticated request is allowed; the middleware never rejects one.
+ */
+struct AuthMiddleware {
+    /**
+     * @struct context
+     * @brief The per-request state Crow keeps for the middleware.
+     */
+    struct context {
+        AuthContext auth;
+    };
+
+    /**
+     * @brief Sets the secret and issuer the tokens are verified against and the cache of verified
+     * tokens. Call it before the app runs.
+     */
+    void configure(nlohmann::json& settings, const std::string& IP, TokenCache& tokens);
+
+    /**
+     * @brief Verifies and decodes a token, from the TokenCache if it was seen before. For tokens
+     * that do not arrive in the Authorization header, e.g. in a websocket message.
+     * @return The claims, or an unauthenticated context with the error if the token is invalid.
+     */
+    AuthContext authenticate(const std::string& jwt) const;
+
+    void before_handle(crow::request& req, crow::response& res, context& ctx);
+
+    void after_handle(crow::request& req, crow::response& res, context& ctx) {}
+
+private:
+    nlohmann::json* settings = nullptr; /**< Holds the JWT secret. */
+    std::string IP; /**< The issuer and audience of the tokens. */
+    TokenCache* tokens = nullptr; /**< Claims of the tokens already verified. */
+};
+
+/** The Crow application type, with every middleware the routes rely on. */
+using CrowApp = crow::App<crow::CORSHandler, AuthMiddleware>;
+
+/**
+ * @brief Returns the decoded JWT of a request.
+ */
+inline const AuthContext& authOf(CrowApp& app, const crow::request& req) {
+    return app.get_context<AuthMiddleware>(req).auth;
+}
@@ -2,6 +2,7 @@
 
 #include <crow.h>
 #include <crow/middlewares/cors.h>
+#include "auth_middleware.hpp"
 
 // show the languages that are accepted
-void ROUTE_Languages(crow::App<crow::CORSHandler>& app, std::vector<std::string>& accepted_languages);
\ No newline at end of file
+void ROUTE_Languages(CrowApp& app, std::vector<std::string>& accepted_languages);
\ No newline at end of file
@@ -4,30 +4,64 @@
  */
 #include "login.hpp"
 
-#include <bcrypt/BCrypt.hpp>
+#include "async_response.hpp"
 #include "../Programs/jwt.hpp"
 
-void ROUTE_Login(crow::App<crow::CORSHandler>& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI) {
+void ROUTE_Login(CrowApp& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<DBExecutor>& executor, std::unique_ptr<PasswordHasher>& hasher) {
     CROW_ROUTE(app, "/login")
     .methods("POST"_method)
-    ([&settings, &sqlAPI, IP](const crow::request& req) {
-        nlohmann::json body = nlohmann::json::parse(req.body);
-        std::string query = "SELECT * FROM users WHERE email = ?;";
-        std::unique_ptr<sql::PreparedStatement> pstmt = sqlAPI->prepareStatement(query);
-        pstmt->setString(1, body["email"].get<std::string>());
-        std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-        if (res->next()) {
-            if (BCrypt::validatePassword(body["password"].get<std::string>(), res->getString("password"))) {
-                std::string JWT = JWT::generateJWT(settings, IP, res->getInt("id"), sqlAPI);
-                crow::response response(200, "{\"JWT\": \"" + JWT + "\", \"name\": \"" + res->getString("name") + "\"}");
-                return response;
-            } else {
-                crow::response response(400, "{\"error\": \"Invalid email or password\"}");
-                return response;
+    ([&settings, &sqlAPI, &executor, &hasher, IP](const crow::request& req, crow::response& response) {
+        QueryStats::Route route("/login");
+        nlohmann::json body = nlohmann::json::parse(req.body, nullptr, false);
+        if (!body.is_object() || !body["email"].is_string() || !body["password"].is_string()) {
+            respondNow(response, crow::response(400, "{\"error\": \"Invalid email or password\"}"));
+            return;
+        }
+        std::string email = body["email"].get<std::string>();
+        std::string password = body["password"].get<std::string>();
+
+        // look the user up on a database thread, check the password on a hashing thread, then sign
+        // the token on a database thread again; the Crow worker is free the whole time
+        bool queued = executor->post([&settings, &sqlAPI, &executor, &hasher, IP, &response, email, password, routeName = QueryStats::currentRoute()] {
+            QueryStats::Route route(routeName);
+            int user_id;
+            std::string name, stored;
+            try {
+                std::string query = "SELECT id, name, password FROM users WHERE email = ?;";
+                std::unique_ptr<PooledStatement> pstmt = sqlAPI->prepareStatement(query);
+                pstmt->setString(1, email);
+                std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+                if (!res->next()) {
+                    respondNow(response, crow::response(400, "{\"error\": \"Invalid email or password\"}"));
+                    return;
+                }
+                user_id = res->getInt("id");
+                name = res->getString("name");
+                stored = res->getString("password");
+            } catch (const std::exception& e) {
+                CROW_LOG_ERROR << "Exception occurred: " << e.what();
+                respondNow(response, crow::response(500, R"({"error": "Internal server error"})"));
+                return;
+            }
+            bool hashing = hasher->verify(password, stored, [&settings, &sqlAPI, &executor, IP, &response, user_id, name, routeName](bool ok) {
+                if (!ok) {
+                    respondNow(response, crow::response(400, "{\"error\": \"Invalid email or password\"}"));
+                    return;
+                }
+                QueryStats::Route route(routeName);
+                respondAsync(*executor, response, [&settings, &sqlAPI, IP, user_id, name] {
+                    nlohmann::json res;
+                    res["JWT"] = JWT::generateJWT(settings, IP, user_id, sqlAPI);
+                    res["name"] = name;
+                    return crow::response(200, res.dump());
+                });
+            });
+            if (!hashing) {
+                respondNow(response, crow::response(503, R"({"error": "Server busy, try again later"})"));
             }
-        } else {
-            crow::response response(400, "{\"error\": \"Invalid email or password\"}");
-            return response;
+        });
+        if (!queued) {
+            respondNow(response, crow::response(503, R"({"error": "Server busy, try again later"})"));
         }
     });
-}
\ No newline at end of file
+}
@@ -13,7 +13,10 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
+#include "../API/db_executor.hpp"
+#include "../Programs/password_hasher.hpp"
 
 /**
  * @brief Implements the login functionality as a POST route using the CROW library.
@@ -21,7 +24,8 @@
  * This function sets up a POST route at "/login" for user authentication. It expects
  * a JSON payload in the request body containing the user's email and password. The function
  * then queries the database for a user with the provided email. If a user is found, it
- * validates the password using BCrypt. Upon successful validation, it generates a JSON Web Token (JWT)
+ * validates the password using BCrypt on the hashing pool, and the response is completed from there
+ * rather than on the Crow worker thread. Upon successful validation, it generates a JSON Web Token (JWT)
  * using the user's ID, the application settings, and the server IP address. The JWT is then returned
  * to the client. If the email or password is invalid, it returns an error message.
  * 
@@ -29,7 +33,9 @@
  * @param settings A JSON object containing the application settings, including permissions.
  * @param IP The IP address of the backend server.
  * @param sqlAPI A pointer to the SQL API object for database operations.
+ * @param executor Runs the queries, so the Crow worker thread is not blocked.
+ * @param hasher Checks the password on its own threads; the route answers 503 when its queue is full.
  * 
  * @note The route is defined to listen for POST requests only.
  */
-void ROUTE_Login(crow::App<crow::CORSHandler>& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI);
\ No newline at end of file
+void ROUTE_Login(CrowApp& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<DBExecutor>& executor, std::unique_ptr<PasswordHasher>& hasher);
\ No newline at end of file
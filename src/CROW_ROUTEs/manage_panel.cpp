@@ -1,8 +1,12 @@
 #include "manage_panel.hpp"
 
-void ROUTE_manage_panel(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& modifyAPI, std::unique_ptr<APIs>& API){
-    problemsRoute(app, settings, IP, API, modifyAPI);
-    problemRoute(app, settings, IP, API);
-    testcaseRoute(app, settings, IP, API, modifyAPI);
+void ROUTE_manage_panel(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<DBExecutor>& executor, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, VerdictHub& verdict_hub, std::unique_ptr<JudgeQueue>& judge_queue, std::unique_ptr<Rejudger>& rejudger, std::unique_ptr<TokenCache>& token_cache, PermissionIndex& permission_index, std::unique_ptr<PasswordHasher>& password_hasher, cache::lru_cache<int, nlohmann::json>& problem_cache){
+    problemsRoute(app, settings, IP, API, problem_counters, permission_index, problem_cache);
+    problemRoute(app, settings, IP, API, problem_counters, test_case_cache, permission_index, problem_cache);
+    testcaseRoute(app, settings, IP, API, test_case_cache, permission_index);
+    rejudgeRoute(app, settings, IP, API, rejudger, permission_index);
+    judgingRoute(app, settings, IP, API, test_case_cache, permission_index);
+    metricsRoute(app, settings, IP, API, executor, problem_counters, test_case_cache, verdict_hub, judge_queue, token_cache, permission_index, password_hasher);
+    tokenCacheRoute(app, settings, token_cache);
 }
 
@@ -3,11 +3,26 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
+#include "../API/db_executor.hpp"
+#include "../API/judge_queue.hpp"
+#include "../API/permission_index.hpp"
+#include "../API/rejudger.hpp"
+#include "../API/test_case_cache.hpp"
+#include "../API/verdict_hub.hpp"
 #include "../Programs/jwt.hpp"
+#include "../Programs/problem_counters.hpp"
+#include "../Programs/password_hasher.hpp"
+#include "../Programs/token_cache.hpp"
+#include "../include/lrucache.hpp"
 
 #include "manage_panel_routes/problems.hpp"
 #include "manage_panel_routes/problem.hpp"
 #include "manage_panel_routes/testcases.hpp"
+#include "manage_panel_routes/metrics.hpp"
+#include "manage_panel_routes/rejudge.hpp"
+#include "manage_panel_routes/judging.hpp"
+#include "manage_panel_routes/token_cache.hpp"
 
-void ROUTE_manage_panel(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& modifyAPI, std::unique_ptr<APIs>& API);
\ No newline at end of file
+void ROUTE_manage_panel(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<DBExecutor>& executor, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, VerdictHub& verdict_hub, std::unique_ptr<JudgeQueue>& judge_queue, std::unique_ptr<Rejudger>& rejudger, std::unique_ptr<TokenCache>& token_cache, PermissionIndex& permission_index, std::unique_ptr<PasswordHasher>& password_hasher, cache::lru_cache<int, nlohmann::json>& problem_cache);
\ No newline at end of file
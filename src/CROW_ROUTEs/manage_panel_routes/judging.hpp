@@ -0,0 +1,81 @@
+#pragma once
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <algorithm>
+#include <nlohmann/json.hpp>
+#include "../auth_middleware.hpp"
+#include "../../API/api.hpp"
+#include "../../API/test_case_cache.hpp"
+#include "../../API/permission_index.hpp"
+
+namespace {
+const std::vector<std::string> judge_modes = {"all", "first_failure"};
+
+crow::response getJudging(std::unique_ptr<APIs>& API, int problem_id) {
+    std::unique_ptr<PooledStatement> pstmt(API->prepareStatement("SELECT judge_mode, judge_chunk_size FROM problems WHERE id = ?;"));
+    pstmt->setInt(1, problem_id);
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    if (!res->next()) {
+        return crow::response(404, "Problem not found");
+    }
+    nlohmann::json judging;
+    judging["mode"] = std::string(res->getString("judge_mode"));
+    judging["chunk_size"] = res->getInt("judge_chunk_size");
+    return crow::response(200, judging.dump());
+}//getJudging
+
+crow::response putJudging(const crow::request& req, std::unique_ptr<APIs>& API, TestCaseCache& test_case_cache, int problem_id) {
+    nlohmann::json body = nlohmann::json::parse(req.body, nullptr, false);
+    if (!body.is_object() || !body.contains("mode") || !body["mode"].is_string()
+        || std::find(judge_modes.begin(), judge_modes.end(), body["mode"].get<std::string>()) == judge_modes.end()) {
+        return crow::response(400, "{\"error\": \"mode must be \\\"all\\\" or \\\"first_failure\\\"\"}");
+    }
+    int chunk_size = 0;
+    if (body.contains("chunk_size")) {
+        if (!body["chunk_size"].is_number_integer() || body["chunk_size"].get<int>() < 0) {
+            return crow::response(400, "{\"error\": \"chunk_size must be a non-negative integer\"}");
+        }
+        chunk_size = body["chunk_size"].get<int>();
+    }
+    std::unique_ptr<PooledStatement> pstmt(API->prepareStatement("UPDATE problems SET judge_mode = ?, judge_chunk_size = ? WHERE id = ?;"));
+    pstmt->setString(1, body["mode"].get<std::string>());
+    pstmt->setInt(2, chunk_size);
+    pstmt->setInt(3, problem_id);
+    pstmt->execute();
+    // the settings are part of the cached bundle
+    test_case_cache.invalidate(problem_id);
+    return crow::response(200, "Judging settings updated");
+}//putJudging
+}//namespace
+
+/**
+ * @brief Configures "/manage_panel/problems/<id>/judging" for users who may edit the problem.
+ *
+ * The body is {"mode": "all" | "first_failure", "chunk_size": n}. In the "first_failure" mode a
+ * submission stops being judged at its first failing test case, the ones failed most often being
+ * tried first. In the "all" mode a chunk size above 0 splits the test cases into chunks of that
+ * many, judged at once on several sandbox nodes; 0 or no chunk_size sends them in one request.
+ */
+inline void judgingRoute(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, TestCaseCache& test_case_cache, PermissionIndex& permission_index) {
+    CROW_ROUTE(app, "/manage_panel/problems/<int>/judging")
+    .methods("GET"_method, "PUT"_method)
+    ([&settings, &API, &test_case_cache, &permission_index, &app](const crow::request& req, int problem_id){
+        QueryStats::Route route("/manage_panel/problems/<int>/judging");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, "Unauthorized");
+        }
+        if (!permission_index.allows(auth, problem_id, settings["permission_flags"]["problems"]["edit"].get<int>())) {
+            return crow::response(403, "Forbidden");
+        }
+        try {
+            if (req.method == "PUT"_method) {
+                return putJudging(req, API, test_case_cache, problem_id);
+            }
+            return getJudging(API, problem_id);
+        } catch (const std::exception& e) {
+            return crow::response(500, e.what());
+        }
+    });
+}//judgingRoute
@@ -0,0 +1,160 @@
+#pragma once
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <nlohmann/json.hpp>
+#include <algorithm>
+#include "../auth_middleware.hpp"
+#include "../../API/api.hpp"
+#include "../../API/db_executor.hpp"
+#include "../../API/judge_queue.hpp"
+#include "../../API/permission_index.hpp"
+#include "../../API/test_case_cache.hpp"
+#include "../../API/verdict_hub.hpp"
+#include "../../Programs/jwt.hpp"
+#include "../../Programs/problem_counters.hpp"
+#include "../../Programs/password_hasher.hpp"
+#include "../../Programs/token_cache.hpp"
+
+inline void metricsRoute(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<DBExecutor>& executor, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, VerdictHub& verdict_hub, std::unique_ptr<JudgeQueue>& judge_queue, std::unique_ptr<TokenCache>& token_cache, PermissionIndex& permission_index, std::unique_ptr<PasswordHasher>& password_hasher) {
+    CROW_ROUTE(app, "/manage_panel/metrics")
+    .methods("GET"_method)
+    ([&settings, &API, &executor, &problem_counters, &test_case_cache, &verdict_hub, &judge_queue, &token_cache, &permission_index, &password_hasher, &app](const crow::request& req){
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, "Unauthorized");
+        }
+        // site admins only
+        if (!auth.isSiteAdmin()) {
+            return crow::response(403, "Forbidden");
+        }
+        nlohmann::json metrics;
+        APIs::StatementCacheStats statementCache = API->statementCacheStats();
+        metrics["sql"]["statement_cache"]["hits"] = statementCache.hits;
+        metrics["sql"]["statement_cache"]["misses"] = statementCache.misses;
+        metrics["sql"]["pool"]["size"] = API->connectionPool()->size();
+        metrics["sql"]["pool"]["idle"] = API->connectionPool()->idleCount();
+        metrics["sql"]["replicas"]["configured"] = API->replicaCount();
+        metrics["sql"]["replicas"]["healthy"] = API->healthyReplicaCount();
+        APIs::TransactionStats transactions = API->transactionStats();
+        metrics["sql"]["transactions"]["count"] = transactions.count;
+        metrics["sql"]["transactions"]["total_us"] = transactions.total_us;
+        metrics["sql"]["transactions"]["max_us"] = transactions.max_us;
+        metrics["sql"]["executor"]["threads"] = executor->threadCount();
+        metrics["sql"]["executor"]["queue_depth"] = executor->queueDepth();
+        metrics["sql"]["executor"]["rejected"] = executor->rejectedCount();
+        // latency per statement fingerprint, slowest in total first
+        std::vector<QueryStats::Fingerprint> fingerprints = API->queryStats().fingerprints();
+        std::sort(fingerprints.begin(), fingerprints.end(), [](const QueryStats::Fingerprint& a, const QueryStats::Fingerprint& b) {
+            return a.exec_us + a.wait_us > b.exec_us + b.wait_us;
+        });
+        metrics["sql"]["queries"] = nlohmann::json::array();
+        for (size_t i = 0; i < fingerprints.size() && i < 50; i++) {
+            const QueryStats::Fingerprint& fingerprint = fingerprints[i];
+            nlohmann::json query;
+            query["sql"] = fingerprint.sql;
+            query["binds"] = fingerprint.binds;
+            query["count"] = fingerprint.count;
+            query["wait_us"] = fingerprint.wait_us;
+            query["exec_us"] = fingerprint.exec_us;
+            query["rows"] = fingerprint.rows;
+            query["errors"] = fingerprint.errors;
+            for (size_t bucket = 0; bucket < fingerprint.buckets.size(); bucket++) {
+                std::string le = bucket < QueryStats::bucket_bounds_us.size() ? std::to_string(QueryStats::bucket_bounds_us[bucket]) : "inf";
+                query["histogram_us"][le] = fingerprint.buckets[bucket];
+            }
+            metrics["sql"]["queries"].push_back(query);
+        }
+        metrics["sql"]["slow_queries"] = nlohmann::json::array();
+        for (const auto& slow : API->queryStats().slowQueries()) {
+            nlohmann::json query;
+            query["sql"] = slow.sql;
+            query["binds"] = slow.binds;
+            query["wait_us"] = slow.wait_us;
+            query["exec_us"] = slow.exec_us;
+            query["rows"] = slow.rows;
+            query["failed"] = slow.failed;
+            query["route"] = slow.route;
+            query["at"] = std::chrono::duration_cast<std::chrono::seconds>(slow.at.time_since_epoch()).count();
+            metrics["sql"]["slow_queries"].push_back(query);
+        }
+        ProblemCounters::Stats counters = problem_counters.stats();
+        metrics["problem_counters"]["hits"] = counters.hits;
+        metrics["problem_counters"]["misses"] = counters.misses;
+        metrics["problem_counters"]["entries"] = counters.entries;
+        TokenCache::Stats tokens = token_cache->stats();
+        metrics["auth"]["token_cache"]["hits"] = tokens.hits;
+        metrics["auth"]["token_cache"]["misses"] = tokens.misses;
+        metrics["auth"]["token_cache"]["expired"] = tokens.expired;
+        metrics["auth"]["token_cache"]["flushes"] = tokens.flushes;
+        metrics["auth"]["token_cache"]["entries"] = tokens.entries;
+        metrics["auth"]["token_cache"]["max_entries"] = tokens.max_entries;
+        metrics["auth"]["token_cache"]["hit_rate"] = tokens.hits + tokens.misses > 0 ? double(tokens.hits) / (tokens.hits + tokens.misses) : 0.0;
+        PermissionIndex::Stats permissions = permission_index.stats();
+        metrics["auth"]["permission_index"]["problems"] = permissions.problems;
+        metrics["auth"]["permission_index"]["grants"] = permissions.grants;
+        metrics["auth"]["permission_index"]["checks"] = permissions.checks;
+        metrics["auth"]["permission_index"]["reloads"] = permissions.reloads;
+        PasswordHasher::Stats hashing = password_hasher->stats();
+        metrics["auth"]["password_hasher"]["threads"] = hashing.threads;
+        metrics["auth"]["password_hasher"]["queue_depth"] = hashing.queue_depth;
+        metrics["auth"]["password_hasher"]["completed"] = hashing.completed;
+        metrics["auth"]["password_hasher"]["rejected"] = hashing.rejected;
+        metrics["auth"]["password_hasher"]["wait_us_total"] = hashing.wait_us_total;
+        metrics["auth"]["password_hasher"]["wait_us_max"] = hashing.wait_us_max;
+        metrics["auth"]["password_hasher"]["hash_us_total"] = hashing.hash_us_total;
+        metrics["auth"]["password_hasher"]["cost"] = hashing.cost;
+        JudgeQueue::Stats judge = judge_queue->stats();
+        metrics["judge"]["workers"] = judge.workers;
+        metrics["judge"]["queue_depth"] = judge.queue_depth;
+        metrics["judge"]["in_flight"] = judge.in_flight;
+        metrics["judge"]["completed"] = judge.completed;
+        metrics["judge"]["failed"] = judge.failed;
+        metrics["judge"]["chunks"]["threads"] = judge.chunk_threads;
+        metrics["judge"]["chunks"]["queue_depth"] = judge.chunk_queue_depth;
+        metrics["judge"]["chunks"]["inline"] = judge.chunks_inline;
+        metrics["judge"]["rejected"] = judge.rejected;
+        metrics["judge"]["wait_us_total"] = judge.wait_us_total;
+        metrics["judge"]["wait_us_max"] = judge.wait_us_max;
+        metrics["judge"]["judge_us_total"] = judge.judge_us_total;
+        for (size_t i = 0; i < JudgeQueue::priority_count; i++) {
+            const JudgeQueue::ClassStats& priorityClass = judge.classes[i];
+            nlohmann::json& entry = metrics["judge"]["classes"][JudgeQueue::priorityName(static_cast<JudgeQueue::Priority>(i))];
+            entry["queue_depth"] = priorityClass.queue_depth;
+            entry["users"] = priorityClass.users;
+            entry["in_flight"] = priorityClass.in_flight;
+            entry["max_in_flight"] = priorityClass.max_in_flight;
+        }
+        TestCaseCache::Stats testCases = test_case_cache.stats();
+        metrics["judge"]["test_case_cache"]["hits"] = testCases.hits;
+        metrics["judge"]["test_case_cache"]["misses"] = testCases.misses;
+        metrics["judge"]["test_case_cache"]["coalesced"] = testCases.coalesced;
+        metrics["judge"]["test_case_cache"]["evictions"] = testCases.evictions;
+        metrics["judge"]["test_case_cache"]["entries"] = testCases.entries;
+        metrics["judge"]["test_case_cache"]["bytes"] = testCases.bytes;
+        metrics["judge"]["test_case_cache"]["max_bytes"] = testCases.max_bytes;
+        VerdictCache::Stats verdicts = judge_queue->verdictStats();
+        metrics["judge"]["verdict_cache"]["hits"] = verdicts.hits;
+        metrics["judge"]["verdict_cache"]["misses"] = verdicts.misses;
+        metrics["judge"]["verdict_cache"]["entries"] = verdicts.entries;
+        metrics["judge"]["verdict_cache"]["hit_rate"] = verdicts.hits + verdicts.misses > 0 ? double(verdicts.hits) / (verdicts.hits + verdicts.misses) : 0.0;
+        VerdictHub::Stats stream = verdict_hub.stats();
+        metrics["judge"]["stream"]["submissions"] = stream.submissions;
+        metrics["judge"]["stream"]["subscribers"] = stream.subscribers;
+        metrics["judge"]["stream"]["published"] = stream.published;
+        metrics["judge"]["nodes"] = nlohmann::json::array();
+        for (const auto& node : judge_queue->sandboxStats()) {
+            nlohmann::json entry;
+            entry["url"] = node.url;
+            entry["weight"] = node.weight;
+            entry["capacity"] = node.capacity;
+            entry["outstanding"] = node.outstanding;
+            entry["ejected"] = node.ejected;
+            entry["consecutive_failures"] = node.consecutive_failures;
+            entry["completed"] = node.completed;
+            entry["failed"] = node.failed;
+            metrics["judge"]["nodes"].push_back(entry);
+        }
+        return crow::response(200, metrics.dump());
+    });
+}//metricsRoute
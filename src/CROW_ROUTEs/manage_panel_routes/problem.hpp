@@ -2,10 +2,14 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "../auth_middleware.hpp"
 #include "../../API/api.hpp"
-#include "../../Programs/jwt.hpp"
+#include "../../API/test_case_cache.hpp"
+#include "../../API/permission_index.hpp"
+#include "../../Programs/problem_counters.hpp"
+#include "../../include/lrucache.hpp"
 namespace {
-crow::response PUT(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API, nlohmann::json& settings, int problem_id) {
+crow::response PUT(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, nlohmann::json& settings, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, PermissionIndex& permission_index, cache::lru_cache<int, nlohmann::json>& problem_cache, int problem_id) {
     // update the problem
     //check if the table correct
     nlohmann::json body = nlohmann::json::parse(req.body);
@@ -19,14 +23,14 @@ crow::response PUT(const crow::request& req, std::string jwt, std::unique_ptr<AP
     if(body["table"] == "problems"){
         //update the problem
         std::string query = "UPDATE problems SET " + body["column"].get<std::string>() + " = ? WHERE id = ?";
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
         pstmt->setString(1, body["value"].get<std::string>());
         pstmt->setInt(2, problem_id);
         pstmt->execute();
     } else {
         //update the problem
         std::string query = "UPDATE " + body["table"].get<std::string>() + " SET " + body["column"].get<std::string>() + " = ? WHERE problem_id = ?";
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
         if(body["value"].is_string()){
             pstmt->setString(1, body["value"].get<std::string>());
         } else {
@@ -34,11 +38,18 @@ crow::response PUT(const crow::request& req, std::string jwt, std::unique_ptr<AP
         }
         pstmt->setInt(2, problem_id);
         pstmt->execute();
+        if (body["table"] == "problem_role") {
+            problem_counters.invalidate();
+            permission_index.reload(*API, problem_id);
+        } else if (body["table"] == "problem_test_cases") {
+            test_case_cache.invalidate(problem_id);
+        }
     }
+    problem_cache.erase(problem_id);
     return crow::response(200, "Problem updated");
 }
 
-crow::response DELETE(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API, nlohmann::json& settings, int problem_id) {
+crow::response DELETE(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, nlohmann::json& settings, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, PermissionIndex& permission_index, cache::lru_cache<int, nlohmann::json>& problem_cache, int problem_id) {
     try {
         // Start a transaction
         API->beginTransaction();
@@ -49,7 +60,7 @@ crow::response DELETE(const crow::request& req, std::string jwt, std::unique_ptr
             JOIN problem_submissions ps ON pst.submission_id = ps.id
             WHERE ps.problem_id = ?
         )";
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
         pstmt->setInt(1, problem_id);
         pstmt->execute();
 
@@ -79,6 +90,10 @@ crow::response DELETE(const crow::request& req, std::string jwt, std::unique_ptr
         pstmt->execute();
 
         API->commitTransaction();
+        problem_counters.invalidate();
+        test_case_cache.invalidate(problem_id);
+        permission_index.reload(*API, problem_id);
+        problem_cache.erase(problem_id);
         return crow::response(200, "Problem deleted");
     } catch (const std::exception& e) {
         // Rollback the transaction in case of an error
@@ -88,25 +103,25 @@ crow::response DELETE(const crow::request& req, std::string jwt, std::unique_ptr
 }
 }//namespace
 
-inline void problemRoute(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API) {
+inline void problemRoute(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, ProblemCounters& problem_counters, TestCaseCache& test_case_cache, PermissionIndex& permission_index, cache::lru_cache<int, nlohmann::json>& problem_cache) {
     CROW_ROUTE(app, "/manage_panel/problems/<int>")
     .methods("PUT"_method, "DELETE"_method)
-    ([&settings, &API, IP](const crow::request& req, int problem_id){
-        // verify the JWT(user must login first)
-        std::string jwt = req.get_header_value("Authorization");
-        try {
-            JWT::verifyJWT(jwt, settings, IP);
-        } catch (const std::exception& e) {
+    ([&settings, &API, &problem_counters, &test_case_cache, &permission_index, &problem_cache, &app](const crow::request& req, int problem_id){
+        QueryStats::Route route("/manage_panel/problems/<int>");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
             return crow::response(401, "Unauthorized");
         }
+        APIs::ReadYourWrites readYourWrites(*API, auth.user_id);
         //if the user is not a site admin and dont got the permission
-        if (!JWT::isPermissioned(jwt, problem_id, API, settings["permission_flags"]["problems"]["edit"].get<int>())) {
+        if (!permission_index.allows(auth, problem_id, settings["permission_flags"]["problems"]["edit"].get<int>())) {
             return crow::response(403, "Forbidden");
         }
         if (req.method == "PUT"_method) {
-            return PUT(req, jwt, API, settings, problem_id);
+            return PUT(req, auth, API, settings, problem_counters, test_case_cache, permission_index, problem_cache, problem_id);
         } else /*if (req.method == "DELETE"_method)*/ {
-            return DELETE(req, jwt, API, settings, problem_id);
+            return DELETE(req, auth, API, settings, problem_counters, test_case_cache, permission_index, problem_cache, problem_id);
         }
     });
 }//problemRoute
\ No newline at end of file
@@ -2,9 +2,17 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include <algorithm>
+#include <optional>
 #include <sstream>
+#include "../auth_middleware.hpp"
 #include "../../API/api.hpp"
+#include "../../API/permission_index.hpp"
+#include "../../API/row_mapper.hpp"
 #include "../../Programs/jwt.hpp"
+#include "../../Programs/cursor.hpp"
+#include "../../Programs/problem_counters.hpp"
+#include "../../include/lrucache.hpp"
 
 #define badReq(reason) { \
     std::ostringstream oss; \
@@ -13,93 +21,102 @@
     return crow::response(400, oss.str()); \
 }    
 namespace {
-inline crow::response GET(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API) {
-    u_int32_t problemsPerPage = 30, offset = 0, problemsCount = 0;
+inline crow::response GET(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, const nlohmann::json& settings, ProblemCounters& problem_counters) {
+    u_int32_t problemsPerPage = 30, offset = 0;
+    int64_t problemsCount = 0;
     if (req.url_params.get("problemsPerPage")) {
         problemsPerPage = std::stoi(req.url_params.get("problemsPerPage"));
     }
+    problemsPerPage = std::clamp<u_int32_t>(problemsPerPage, 1, settings.value("max_problems_per_page", 100));
     if (req.url_params.get("offset")) {
         offset = std::stoi(req.url_params.get("offset"));
     }
+    // keyset pagination: the cursor replaces offset
+    std::optional<int64_t> afterId;
+    if (req.url_params.get("after")) {
+        afterId = Cursor::decode(req.url_params.get("after"));
+        if (!afterId) {
+            std::ostringstream oss;
+            oss << "{\"error\": \"Invalid cursor\"}";
+            return crow::response(400, oss.str());
+        }
+    }
+    std::string pagination = afterId ? "ORDER BY p.id LIMIT ?" : "ORDER BY p.id LIMIT ? OFFSET ?";
 
-    std::string query = "SELECT p.id, u.name AS owner_name, p.title, p.difficulty "
+    std::string query = "SELECT DISTINCT p.id, u.name AS owner_name, p.title, p.difficulty "
                         "FROM problems p "
                         "JOIN users u ON p.owner_id = u.id ";
-    std::string countQuery = "SELECT COUNT(*) "
-                             "FROM problems p "
-                             "JOIN users u ON p.owner_id = u.id ";
 
-    std::unique_ptr<sql::PreparedStatement> pstmt;
-    std::unique_ptr<sql::PreparedStatement> countPstmt;
+    std::unique_ptr<PooledStatement> pstmt;
+    unsigned int next = 1;
+    ProblemCounters::Scope scope = ProblemCounters::Scope::All;
+    std::vector<std::string> roleNames;
 
     // If the user is a site admin
-    if (JWT::getSitePermissionFlags(jwt) & 1) {
+    if (auth.isSiteAdmin()) {
         // Get all the problems
-        query += "LIMIT ? OFFSET ?";
-        pstmt = API->prepareStatement(query);
-        pstmt->setInt(1, problemsPerPage);
-        pstmt->setInt(2, offset);
-
-        // Get the count of all the problems
-        countPstmt = API->prepareStatement(countQuery);
+        if (afterId) {
+            query += "WHERE p.id > ? ";
+        }
+        query += pagination;
+        pstmt = API->prepareStatement(query, APIs::Access::Read);
     } else {
-        std::string roleFilter = "JOIN problem_role pr ON p.id = pr.problem_id "
-                                 "WHERE pr.role_name IN (";
-        std::string permissionFilter = ") AND pr.permission_flags & 1 <> 0 ";
-
         // Get the roles
-        nlohmann::json roles = JWT::getRoles(jwt);
+        roleNames = auth.roleNames();
 
         // Handle case where roles are empty
-        if (roles.empty()) {
+        if (roleNames.empty()) {
             std::ostringstream oss;
             oss << "{\"error\": \"No roles found\"}";
             return crow::response(404, oss.str());
         }
 
         // Get the problems that the user has permission to modify
-        query += roleFilter;
-        countQuery += roleFilter;
-        for (size_t i = 0; i < roles.size(); ++i) {
-            query += "?";
-            countQuery += "?";
-            if (i < roles.size() - 1) {
-                query += ", ";
-                countQuery += ", ";
-            }
-        }
-        query += permissionFilter;
-        query += "LIMIT ? OFFSET ?";
-        pstmt = API->prepareStatement(query);
-        countQuery += permissionFilter;
-        countPstmt = API->prepareStatement(countQuery);
-
-        for (size_t i = 0; i < roles.size(); ++i) {
-            pstmt->setString(i + 1, roles[i].get<std::string>());
-            countPstmt->setString(i + 1, roles[i].get<std::string>());
+        scope = ProblemCounters::Scope::Manage;
+        query += "JOIN problem_role pr ON p.id = pr.problem_id "
+                 "WHERE pr.role_name IN (" + APIs::inPlaceholders(roleNames.size()) + ") AND pr.permission_flags & 1 <> 0 ";
+        if (afterId) {
+            query += "AND p.id > ? ";
         }
-        pstmt->setInt(roles.size() + 1, problemsPerPage);
-        pstmt->setInt(roles.size() + 2, offset);
+        query += pagination;
+        pstmt = API->prepareStatement(query, APIs::Access::Read);
+        next = pstmt->setStringList(1, roleNames);
+    }
+    if (afterId) {
+        pstmt->setInt64(next++, *afterId);
+    }
+    pstmt->setInt(next++, problemsPerPage);
+    if (!afterId) {
+        pstmt->setInt(next, offset);
     }
 
     nlohmann::json res, problems;
     try {
+        static const RowMapper mapper({
+            {"id", RowMapper::Type::Int},
+            {"owner_name", RowMapper::Type::String},
+            {"title", RowMapper::Type::String},
+            {"difficulty", RowMapper::Type::String}
+        });
         std::unique_ptr<sql::ResultSet> resultSet(pstmt->executeQuery());
-        while (resultSet->next()) {
-            nlohmann::json problem;
-            problem["id"] = resultSet->getInt("id");
-            problem["owner_name"] = resultSet->getString("owner_name");
-            problem["title"] = resultSet->getString("title");
-            problem["difficulty"] = resultSet->getInt("difficulty");
-            problems.push_back(problem);
-        }
+        problems = mapper.map(*resultSet);
 
-        std::unique_ptr<sql::ResultSet> countResultSet(countPstmt->executeQuery());
-        if (countResultSet->next()) {
-            problemsCount = countResultSet->getInt(1);
-        } else {
-            problemsCount = -1;
-        }
+        // the count only changes on manage panel writes, which invalidate problem_counters;
+        // it is read from the primary so replica lag is not cached until the next write
+        problemsCount = problem_counters.get(scope, roleNames, [&API, scope, &roleNames]() -> int64_t {
+            std::string countQuery = "SELECT COUNT(*) FROM problems";
+            std::unique_ptr<PooledStatement> countPstmt;
+            if (scope == ProblemCounters::Scope::All) {
+                countPstmt = API->prepareStatement(countQuery);
+            } else {
+                countQuery = "SELECT COUNT(DISTINCT problem_id) FROM problem_role "
+                             "WHERE role_name IN (" + APIs::inPlaceholders(roleNames.size()) + ") AND permission_flags & 1 <> 0";
+                countPstmt = API->prepareStatement(countQuery);
+                countPstmt->setStringList(1, roleNames);
+            }
+            std::unique_ptr<sql::ResultSet> countResultSet(countPstmt->executeQuery());
+            return countResultSet->next() ? countResultSet->getInt64(1) : -1;
+        });
     } catch (const std::exception& e) {
         std::ostringstream oss;
         oss << "{\"error\": \"" << e.what() << "\"}";
@@ -108,6 +125,9 @@ inline crow::response GET(const crow::request& req, std::string jwt, std::unique
 
     res["problems"] = problems;
     res["problemsCount"] = problemsCount;
+    if (problems.size() == problemsPerPage) {
+        res["next"] = Cursor::encode(problems.back()["id"].get<int64_t>());
+    }
 
     if (problems.empty()) {
         std::ostringstream oss;
@@ -118,7 +138,27 @@ inline crow::response GET(const crow::request& req, std::string jwt, std::unique
     }
 }
 
-inline crow::response POST(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API, const nlohmann::json& setting) {
+// inserts the names missing from a name table (tags, roles) with one lookup and one batch insert
+inline void insertMissingNames(std::unique_ptr<APIs>& API, const std::string& table, std::vector<std::string> names) {
+    std::sort(names.begin(), names.end());
+    names.erase(std::unique(names.begin(), names.end()), names.end());
+    if (names.empty()) {
+        return;
+    }
+    std::unique_ptr<PooledStatement> pstmt(API->prepareStatement("SELECT name FROM " + table + " WHERE name IN (" + APIs::inPlaceholders(names.size()) + ");"));
+    pstmt->setStringList(1, names);
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    while (res->next()) {
+        names.erase(std::remove(names.begin(), names.end(), std::string(res->getString("name"))), names.end());
+    }
+    std::vector<std::vector<APIs::BatchValue>> rows;
+    for (const auto& name : names) {
+        rows.push_back({name});
+    }
+    API->insertBatch(table, {"name"}, rows);
+}
+
+inline crow::response POST(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, const nlohmann::json& setting, ProblemCounters& problem_counters, PermissionIndex& permission_index, cache::lru_cache<int, nlohmann::json>& problem_cache) {
     try {
         // Parse the request body
         nlohmann::json body = nlohmann::json::parse(req.body);
@@ -131,6 +171,40 @@ inline crow::response POST(const crow::request& req, std::string jwt, std::uniqu
         } catch (const std::exception& e) {
             badReq(e.what());
         }
+
+        // Collect and validate the child rows before the transaction starts, so it only spans the inserts.
+        // problem_id is filled in once the problem row exists.
+        std::vector<std::vector<APIs::BatchValue>> sampleRows, tagRows, testcaseRows, roleRows;
+        std::vector<std::string> tagNames, roleNames;
+        try {
+            for (const auto& sample : body["problem_sample_IO"]) {
+                sampleRows.push_back({int64_t(0), sample["input"].get<std::string>(), sample["output"].get<std::string>()});
+            }
+            for (const auto& tag : body["problem_tags"]) {
+                tagNames.push_back(tag.get<std::string>());
+                tagRows.push_back({int64_t(0), tagNames.back()});
+            }
+            int TTS = 0;
+            for (const auto& testcase : body["problem_test_cases"]) {
+                int TL = testcase["time_limit"].get<int>(),
+                    ML = testcase["memory_limit"].get<int>(),
+                    S = testcase["score"].get<int>();
+                if(TL < 0 || ML < 0 || S < 0){
+                    badReq("Invalid test case");
+                }
+                TTS += S;
+                testcaseRows.push_back({int64_t(0), testcase["input"].get<std::string>(), testcase["output"].get<std::string>(), int64_t(TL), int64_t(ML), int64_t(S)});
+            }
+            if(TTS != 10000){
+                badReq("Total test case score must be 10000");
+            }
+            for (const auto& role : body["problem_roles"]) {
+                roleNames.push_back(role["role_name"].get<std::string>());
+                roleRows.push_back({int64_t(0), roleNames.back(), int64_t(role["permission_flags"].get<int>())});
+            }
+        } catch (const std::exception& e) {
+            badReq(e.what());
+        }
         API->beginTransaction();
 
         // Insert the problem
@@ -138,8 +212,8 @@ inline crow::response POST(const crow::request& req, std::string jwt, std::uniqu
         INSERT INTO problems (owner_id, title, description, input_format, output_format, difficulty)
         VALUES (?, ?, ?, ?, ?, ?);
         )";
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
-        pstmt->setInt(1, JWT::getUserID(jwt));
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
+        pstmt->setInt(1, auth.user_id);
         try {
             pstmt->setString(2, body["problem"]["title"].get<std::string>());
             pstmt->setString(3, body["problem"]["description"].get<std::string>());
@@ -157,134 +231,50 @@ inline crow::response POST(const crow::request& req, std::string jwt, std::uniqu
         pstmt->setString(1, body["problem"]["title"].get<std::string>());
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         if (!res->next()) {
+            API->rollbackTransaction();
             return crow::response(500, "Internal server error");
         }
         int problem_id = res->getInt("id");
+        for (auto* rows : {&sampleRows, &tagRows, &testcaseRows, &roleRows}) {
+            for (auto& row : *rows) {
+                row[0] = int64_t(problem_id);
+            }
+        }
 
         // Insert sample IO
-        query = R"(
-        INSERT INTO problem_sample_IO (problem_id, sample_input, sample_output)
-        VALUES (?, ?, ?);
-        )";
         try{
-            for (const auto& sample : body["problem_sample_IO"]) {
-                pstmt = API->prepareStatement(query);
-                pstmt->setInt(1, problem_id);
-                pstmt->setString(2, sample["input"].get<std::string>());
-                pstmt->setString(3, sample["output"].get<std::string>());
-                pstmt->execute();
-            }
+            API->insertBatch("problem_sample_IO", {"problem_id", "sample_input", "sample_output"}, sampleRows);
         } catch (const std::exception& e) {
             badReq(e.what());
         }
 
-        // Insert tags
-        query = R"(
-        INSERT INTO problem_tags (problem_id, tag_name)
-        VALUES (?, ?);
-        )";
-        //check if the tag exists
+        // Insert the tags that do not exist yet, then the problem's tags
         try {
-            for (const auto& tag : body["problem_tags"]) {
-                pstmt = API->prepareStatement("SELECT * FROM tags WHERE name = ?;");
-                pstmt->setString(1, tag.get<std::string>());
-                res.reset(pstmt->executeQuery());
-                if (!res->next()) {
-                    // Insert the tag if it does not exist
-                    try{
-                        pstmt = API->prepareStatement("INSERT INTO tags (name) VALUES (?);");
-                        pstmt->setString(1, tag.get<std::string>());
-                        pstmt->execute();
-                    } catch (const std::exception& e) {
-                        badReq(e.what());
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            badReq(e.what());
-        }
-        try{
-            for (const auto& tag : body["problem_tags"]) {
-                pstmt = API->prepareStatement(query);
-                pstmt->setInt(1, problem_id);
-                pstmt->setString(2, tag.get<std::string>());
-                pstmt->execute();
-            }
+            insertMissingNames(API, "tags", tagNames);
+            API->insertBatch("problem_tags", {"problem_id", "tag_name"}, tagRows);
         } catch (const std::exception& e) {
             badReq(e.what());
         }
 
         // Insert test cases
-        query = R"(
-        INSERT INTO problem_test_cases (problem_id, input, output, time_limit, memory_limit, score)
-        VALUES (?, ?, ?, ?, ?, ?);
-        )";
         try {
-            int TTS = 0;
-            for (const auto& testcase : body["problem_test_cases"]) {
-                std::string I = testcase["input"].get<std::string>(),
-                            O = testcase["output"].get<std::string>();
-                int TL = testcase["time_limit"].get<int>(),
-                    ML = testcase["memory_limit"].get<int>(),
-                    S = testcase["score"].get<int>();
-                if(TL < 0 || ML < 0 || S < 0){
-                    badReq("Invalid test case");
-                }
-                TTS += S;
-                pstmt = API->prepareStatement(query);
-                pstmt->setInt(1, problem_id);
-                pstmt->setString(2, I);
-                pstmt->setString(3, O);
-                pstmt->setInt(4, TL);
-                pstmt->setInt(5, ML);
-                pstmt->setInt(6, S);
-                pstmt->execute();
-            }
-            if(TTS != 10000){
-                badReq("Total test case score must be 10000");
-            }
+            API->insertBatch("problem_test_cases", {"problem_id", "input", "output", "time_limit", "memory_limit", "score"}, testcaseRows);
         } catch (const std::exception& e) {
             badReq(e.what());
         }
 
-        // Insert roles
-        query = R"(
-        INSERT INTO problem_role (problem_id, role_name, permission_flags)
-        VALUES (?, ?, ?);
-        )";
-        //check if the role exists
+        // Insert the roles that do not exist yet, then the problem's roles
         try {
-            for (const auto& role : body["problem_roles"]) {
-                pstmt = API->prepareStatement("SELECT * FROM roles WHERE name = ?;");
-                pstmt->setString(1, role["role_name"].get<std::string>());
-                res.reset(pstmt->executeQuery());
-                if (!res->next()) {
-                    // Insert the role if it does not exist
-                    try{
-                        pstmt = API->prepareStatement("INSERT INTO roles (name) VALUES (?);");
-                        pstmt->setString(1, role["role_name"].get<std::string>());
-                        pstmt->execute();
-                    } catch (const std::exception& e) {
-                        badReq(e.what());
-                    }
-                }
-            }
-        } catch (const std::exception& e) {
-            badReq(e.what());
-        }
-        try {
-            for (const auto& role : body["problem_roles"]) {
-                pstmt = API->prepareStatement(query);
-                pstmt->setInt(1, problem_id);
-                pstmt->setString(2, role["role_name"].get<std::string>());
-                pstmt->setInt(3, role["permission_flags"].get<int>());
-                pstmt->execute();
-            }
+            insertMissingNames(API, "roles", roleNames);
+            API->insertBatch("problem_role", {"problem_id", "role_name", "permission_flags"}, roleRows);
         } catch (const std::exception& e) {
             badReq(e.what());
         }
 
         API->commitTransaction();
+        problem_counters.invalidate();
+        permission_index.reload(*API, problem_id);
+        problem_cache.erase(problem_id);
         return crow::response(200, R"({"message": "Problem created successfully"})");
     } catch (const std::exception& e) {
         CROW_LOG_ERROR << "Exception occurred: " << e.what();
@@ -294,22 +284,21 @@ inline crow::response POST(const crow::request& req, std::string jwt, std::uniqu
 }
 }// namespace
 
-inline void problemsRoute (crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<APIs>& modifyAPI) {
+inline void problemsRoute (CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, ProblemCounters& problem_counters, PermissionIndex& permission_index, cache::lru_cache<int, nlohmann::json>& problem_cache) {
     CROW_ROUTE(app, "/manage_panel/problems")
     .methods("GET"_method, "POST"_method)
-    ([&settings, &API, &modifyAPI, IP](const crow::request& req){
-        // verify the JWT(user must login first)
-        std::string jwt = req.get_header_value("Authorization");
-        try {
-            JWT::verifyJWT(jwt, settings, IP);
-        } catch (const std::exception& e) {
-            CROW_LOG_INFO << e.what();
+    ([&settings, &API, &problem_counters, &permission_index, &problem_cache, &app](const crow::request& req){
+        QueryStats::Route route("/manage_panel/problems");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
             return crow::response(401, "Unauthorized");
         }
+        APIs::ReadYourWrites readYourWrites(*API, auth.user_id);
         if (req.method == "GET"_method) {
-            return GET(req, jwt, API);
+            return GET(req, auth, API, settings, problem_counters);
         } else /*if (req.method == "POST"_method)*/ {
-            return POST(req, jwt, modifyAPI, settings);
+            return POST(req, auth, API, settings, problem_counters, permission_index, problem_cache);
         }
 
     });
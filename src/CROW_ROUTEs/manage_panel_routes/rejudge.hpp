@@ -0,0 +1,64 @@
+#pragma once
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <nlohmann/json.hpp>
+#include "../auth_middleware.hpp"
+#include "../../API/api.hpp"
+#include "../../API/rejudger.hpp"
+#include "../../API/permission_index.hpp"
+
+namespace {
+nlohmann::json progressJSON(const Rejudger::Progress& progress) {
+    nlohmann::json task;
+    task["id"] = progress.id;
+    task["problem_id"] = progress.problem_id;
+    task["state"] = progress.state;
+    if (!progress.error.empty()) {
+        task["error"] = progress.error;
+    }
+    task["total"] = progress.total;
+    task["queued"] = progress.queued;
+    task["judged"] = progress.judged;
+    task["changed"] = progress.changed;
+    task["failed"] = progress.failed;
+    task["started_at"] = std::chrono::duration_cast<std::chrono::seconds>(progress.started_at.time_since_epoch()).count();
+    return task;
+}
+}//namespace
+
+/**
+ * @brief Configures "/manage_panel/problems/<id>/rejudge" for users who may edit the problem.
+ *
+ * POST starts rejudging every judged submission of the problem in the background and answers 202
+ * with the task id; GET lists the progress of the problem's tasks, newest first; DELETE cancels
+ * the problem's waiting and running tasks.
+ */
+inline void rejudgeRoute(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<Rejudger>& rejudger, PermissionIndex& permission_index) {
+    CROW_ROUTE(app, "/manage_panel/problems/<int>/rejudge")
+    .methods("GET"_method, "POST"_method, "DELETE"_method)
+    ([&settings, &API, &rejudger, &permission_index, &app](const crow::request& req, int problem_id){
+        QueryStats::Route route("/manage_panel/problems/<int>/rejudge");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, "Unauthorized");
+        }
+        if (!permission_index.allows(auth, problem_id, settings["permission_flags"]["problems"]["edit"].get<int>())) {
+            return crow::response(403, "Forbidden");
+        }
+        if (req.method == "POST"_method) {
+            nlohmann::json res;
+            res["id"] = rejudger->start(problem_id);
+            return crow::response(202, res.dump());
+        } else if (req.method == "DELETE"_method) {
+            nlohmann::json res;
+            res["cancelled"] = rejudger->cancel(problem_id);
+            return crow::response(200, res.dump());
+        }
+        nlohmann::json tasks = nlohmann::json::array();
+        for (const auto& progress : rejudger->progress(problem_id)) {
+            tasks.push_back(progressJSON(progress));
+        }
+        return crow::response(200, tasks.dump());
+    });
+}//rejudgeRoute
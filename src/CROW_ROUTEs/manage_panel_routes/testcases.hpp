@@ -3,8 +3,11 @@
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
 #include <sstream>
+#include "../auth_middleware.hpp"
 #include "../../API/api.hpp"
-#include "../../Programs/jwt.hpp"
+#include "../../API/row_mapper.hpp"
+#include "../../API/test_case_cache.hpp"
+#include "../../API/permission_index.hpp"
 
 #define badReq(reason) { \
     std::ostringstream oss; \
@@ -13,57 +16,56 @@
     return crow::response(400, oss.str()); \
 }    
 namespace {
-crow::response GET(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API, int problem_id) {
+crow::response GET(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, int problem_id) {
     try{
+        static const RowMapper mapper({
+            {"id", RowMapper::Type::Int},
+            {"problem_id", RowMapper::Type::Int},
+            {"input", RowMapper::Type::String},
+            {"output", RowMapper::Type::String},
+            {"time_limit", RowMapper::Type::Int},
+            {"memory_limit", RowMapper::Type::Int},
+            {"score", RowMapper::Type::Int}
+        });
         std::string query = R"(
-            SELECT *
+            SELECT id, problem_id, input, output, time_limit, memory_limit, score
             FROM problem_test_cases
             WHERE problem_id = ?;
         )";
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
         pstmt->setInt(1, problem_id);
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-        nlohmann::json testcases;
-        while(res->next()) {
-            nlohmann::json testcase;
-            testcase["id"] = res->getInt("id");
-            testcase["problem_id"] = res->getInt("problem_id");
-            testcase["input"] = res->getString("input");
-            testcase["output"] = res->getString("output");
-            testcase["time_limit"] = res->getInt("time_limit");
-            testcase["memory_limit"] = res->getInt("memory_limit");
-            testcase["score"] = res->getInt("score");
-            testcases.push_back(testcase);
-        }
+        nlohmann::json testcases = mapper.map(*res);
         return crow::response(200, testcases.dump());
     } catch (const std::exception& e) {
         badReq(e.what());
     }
 }//GET
-crow::response POST(const crow::request& req, std::string jwt, std::unique_ptr<APIs>& API, int problem_id) {
+crow::response POST(const crow::request& req, const AuthContext& auth, std::unique_ptr<APIs>& API, TestCaseCache& test_case_cache, int problem_id) {
     try{
+    // build the rows before the transaction so it only spans the delete and the batched inserts
+    nlohmann::json testcases = nlohmann::json::parse(req.body);
+    std::vector<std::vector<APIs::BatchValue>> rows;
+    rows.reserve(testcases.size());
+    for (const auto& testcase : testcases) {
+        rows.push_back({
+            int64_t(problem_id),
+            testcase["input"].get<std::string>(),
+            testcase["output"].get<std::string>(),
+            int64_t(testcase["time_limit"].get<int>()),
+            int64_t(testcase["memory_limit"].get<int>()),
+            int64_t(testcase["score"].get<int>())
+        });
+    }
     API->beginTransaction();
     //replace all the testcases
     std::string query = "DELETE FROM problem_test_cases WHERE problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
+    std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
     pstmt->setInt(1, problem_id);
     pstmt->execute();
-    nlohmann::json testcases = nlohmann::json::parse(req.body);
-    query = R"(
-    INSERT INTO problem_test_cases (problem_id, input, output, time_limit, memory_limit, score)
-    VALUES (?, ?, ?, ?, ?, ?);
-    )";
-    for (const auto& testcase : testcases) {
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
-        pstmt->setInt(1, problem_id);
-        pstmt->setString(2, testcase["input"].get<std::string>());
-        pstmt->setString(3, testcase["output"].get<std::string>());
-        pstmt->setInt(4, testcase["time_limit"].get<int>());
-        pstmt->setInt(5, testcase["memory_limit"].get<int>());
-        pstmt->setInt(6, testcase["score"].get<int>());
-        pstmt->execute();
-    }
+    API->insertBatch("problem_test_cases", {"problem_id", "input", "output", "time_limit", "memory_limit", "score"}, rows);
     API->commitTransaction();
+    test_case_cache.invalidate(problem_id);
     return crow::response(200, "Test cases updated");
     } catch (const std::exception& e) {
         badReq(e.what());
@@ -71,24 +73,24 @@ crow::response POST(const crow::request& req, std::string jwt, std::unique_ptr<A
 }//POST
 }//namespace
 
-inline void testcaseRoute(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<APIs>& modifyAPI) {
+inline void testcaseRoute(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, TestCaseCache& test_case_cache, PermissionIndex& permission_index) {
     CROW_ROUTE(app, "/manage_panel/problems/<int>/testcases")
     .methods("GET"_method, "POST"_method, "PUT"_method)
-    ([&settings, &API, &modifyAPI, IP](const crow::request& req, int problem_id){
-        // verify the JWT(user must login first)
-        std::string jwt = req.get_header_value("Authorization");
-        try {
-            JWT::verifyJWT(jwt, settings, IP);
-        } catch (const std::exception& e) {
+    ([&settings, &API, &test_case_cache, &permission_index, &app](const crow::request& req, int problem_id){
+        QueryStats::Route route("/manage_panel/problems/<int>/testcases");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
             return crow::response(401, "Unauthorized");
         }
-        if (!JWT::isPermissioned(jwt, problem_id, API, settings["permission_flags"]["problems"]["edit"].get<int>())) {
+        APIs::ReadYourWrites readYourWrites(*API, auth.user_id);
+        if (!permission_index.allows(auth, problem_id, settings["permission_flags"]["problems"]["edit"].get<int>())) {
             return crow::response(403, "Forbidden");
         }
         if (req.method == "GET"_method) {
-            return GET(req, jwt, API, problem_id);
+            return GET(req, auth, API, problem_id);
         } else if (req.method == "POST"_method) {
-            return POST(req, jwt, modifyAPI, problem_id);
+            return POST(req, auth, API, test_case_cache, problem_id);
         }
     });
 }//testcaseRoute
\ No newline at end of file
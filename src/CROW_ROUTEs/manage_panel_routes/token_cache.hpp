@@ -0,0 +1,31 @@
+#pragma once
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <nlohmann/json.hpp>
+#include "../auth_middleware.hpp"
+#include "../../Programs/token_cache.hpp"
+
+/**
+ * @brief Configures "/manage_panel/token_cache" for site admins.
+ *
+ * DELETE drops every verified token, so after jwt_secret is rotated tokens signed with the old
+ * secret are verified again, and rejected, on their next request.
+ */
+inline void tokenCacheRoute(CrowApp& app, nlohmann::json& settings, std::unique_ptr<TokenCache>& token_cache) {
+    CROW_ROUTE(app, "/manage_panel/token_cache")
+    .methods("DELETE"_method)
+    ([&token_cache, &app](const crow::request& req){
+        QueryStats::Route route("/manage_panel/token_cache");
+        // the JWT was verified by AuthMiddleware (user must login first)
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, "Unauthorized");
+        }
+        // site admins only
+        if (!auth.isSiteAdmin()) {
+            return crow::response(403, "Forbidden");
+        }
+        token_cache->flush();
+        return crow::response(200, "Token cache flushed");
+    });
+}//tokenCacheRoute
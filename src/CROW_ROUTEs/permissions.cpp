@@ -1,17 +1,16 @@
 #include "permissions.hpp"
 #include "../Programs/jwt.hpp"
 
-void ROUTE_permissions(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API){
+void ROUTE_permissions(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API){
     CROW_ROUTE(app, "/permissions")
     .methods("GET"_method)
-    ([&settings, &API, IP](const crow::request& req){
-        std::string jwt = req.get_header_value("Authorization");
-        try {
-            JWT::verifyJWT(jwt, settings, IP);
-        } catch (const std::exception& e) {
-            return crow::response(401, e.what());
+    ([&settings, &API, &app](const crow::request& req){
+        QueryStats::Route route("/permissions");
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, auth.error);
         }
-        nlohmann::json roles = JWT::getRoles(jwt);
+        std::vector<std::string> roles = auth.roleNames();
 
     });
 }
\ No newline at end of file
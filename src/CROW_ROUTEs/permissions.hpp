@@ -3,6 +3,7 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
 
-void ROUTE_permissions(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API);
\ No newline at end of file
+void ROUTE_permissions(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API);
\ No newline at end of file
@@ -2,229 +2,152 @@
  * @file problem.cpp
  * @brief Implementation of the problem route.
  */
+#include "problem.hpp"
 #include "problems.hpp"
+#include "async_response.hpp"
+#include "../API/row_mapper.hpp"
 #include "../Programs/jwt.hpp"
 
 #include <jwt-cpp/jwt.h>
-#include <set>
+#include <optional>
 
 namespace{
-// returns true if the user has the permission to access
-bool have_permission(nlohmann::json& settings, std::string permission_name, const nlohmann::json& user_roles, const nlohmann::json& problem_roles){
-    std::set<std::string> roles_set;
-    try {
-        for (auto& role : user_roles.items()) {
-            roles_set.insert(role.key());
-        }
-
-        for(auto& i : problem_roles) {
-            if(i["permission_flags"].get<int>() & (1 << settings["permissions"][permission_name].get<int>())){
-                if(roles_set.find(i["name"].get<std::string>()) != roles_set.end())
-                    return true;
-            }
-        }
-    } catch (const std::exception& e) {
-    }
-    return false;
+// returns true if one of the roles holds the named problem permission
+bool have_permission(const nlohmann::json& settings, const std::string& permission_name, PermissionIndex& permission_index, int problemId, const std::vector<uint32_t>& roles){
+    return permission_index.allows(problemId, roles, settings["permission_flags"]["problems"][permission_name].get<int>());
 }
 
-nlohmann::json get_problem(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problems WHERE id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
+// loads the problem together with its sample IO, tags, hints and solutions in one round trip
+nlohmann::json get_problem_detail(std::unique_ptr<APIs>& sqlAPI, int problemId) {
+    std::string query = R"(
+        SELECT p.id, p.owner_id, p.title, p.description, p.input_format, p.output_format, p.difficulty,
+            (SELECT JSON_ARRAYAGG(JSON_OBJECT('input', s.sample_input, 'output', s.sample_output))
+                FROM problem_sample_IO s WHERE s.problem_id = p.id) AS sample_io,
+            (SELECT JSON_ARRAYAGG(pt.tag_name)
+                FROM problem_tags pt WHERE pt.problem_id = p.id) AS tags,
+            (SELECT JSON_ARRAYAGG(JSON_OBJECT('title', h.title, 'hint', h.hint))
+                FROM problem_hints h WHERE h.problem_id = p.id) AS hints,
+            (SELECT JSON_ARRAYAGG(JSON_OBJECT('title', ps.title, 'solution', ps.solution, 'owner_id', ps.owner_id))
+                FROM problem_solutions ps WHERE ps.problem_id = p.id) AS solutions
+        FROM problems p
+        WHERE p.id = ?;
+    )";
+    // read from the primary: the result is cached until the problem is edited, so replica lag would stick
+    std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement(query));
     pstmt->setInt(1, problemId);
+    static const RowMapper mapper({
+        {"id", RowMapper::Type::Int},
+        {"owner_id", RowMapper::Type::Int},
+        {"title", RowMapper::Type::String},
+        {"description", RowMapper::Type::String},
+        {"input_format", RowMapper::Type::String},
+        {"output_format", RowMapper::Type::String},
+        {"difficulty", RowMapper::Type::String},
+        {"sample_io", RowMapper::Type::Json},
+        {"tags", RowMapper::Type::Json},
+        {"hints", RowMapper::Type::Json},
+        {"solutions", RowMapper::Type::Json}
+    });
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    if (res->next()) {
-        nlohmann::json problem;
-        problem["id"] = res->getInt("id");
-        problem["owner_id"] = res->getInt("owner_id");
-        problem["name"] = res->getString("name");
-        problem["description"] = res->getString("description");
-        problem["input_format"] = res->getString("input_format");
-        problem["output_format"] = res->getString("output_format");
-        problem["difficulty"] = res->getString("difficulty");
-        return problem;
-    } else {
+    nlohmann::json problem;
+    if (!mapper.mapNext(*res, problem)) {
         throw std::runtime_error("Problem not found");
     }
-}
-
-nlohmann::json get_problem_sample_IO(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problem_sample_IO WHERE problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-    pstmt->setInt(1, problemId);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json sample_io = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json io;
-        io["input"] = res->getString("input");
-        io["output"] = res->getString("output");
-        sample_io.push_back(io);
-    }
-    return sample_io;
-}
-
-nlohmann::json get_problem_tags(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = 
-        "SELECT t.name "
-        "FROM tags t "
-        "JOIN problem_tags pt ON t.id = pt.tag_id "
-        "WHERE pt.problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-    pstmt->setInt(1, problemId);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json tags = nlohmann::json::array();
-    while (res->next()) {
-        tags.push_back(res->getString("name"));
-    }
-    return tags;
+    return problem;
 }
 
 nlohmann::json get_problem_test_cases(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problem_test_cases WHERE problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-    pstmt->setInt(1, problemId);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json test_cases = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json test_case;
-        test_case["id"] = res->getInt("id");
-        test_case["input"] = res->getString("input");
-        test_case["output"] = res->getString("output");
-        test_case["time_limit"] = res->getInt("time_limit");
-        test_case["memory_limit"] = res->getInt("memory_limit");
-        test_case["score"] = res->getInt("score");  // 0 >= score <= 10,000
-        test_cases.push_back(test_case);
-    }
-    return test_cases;
-}
-
-nlohmann::json get_problem_solution(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problem_solutions WHERE problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-    pstmt->setInt(1, problemId);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json solutions = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json solution;
-        solution["title"] = res->getString("title");
-        solution["solution"] = res->getString("solution");
-        solution["owner_id"] = res->getInt("owner_id");
-        solutions.push_back(solution);
-    }
-    return solutions;
-}
-
-nlohmann::json get_problem_hints(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problem_hints WHERE problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
+    static const RowMapper mapper({
+        {"id", RowMapper::Type::Int},
+        {"input", RowMapper::Type::String},
+        {"output", RowMapper::Type::String},
+        {"time_limit", RowMapper::Type::Int},
+        {"memory_limit", RowMapper::Type::Int},
+        {"score", RowMapper::Type::Int}  // 0 >= score <= 10,000
+    });
+    std::string query = "SELECT id, input, output, time_limit, memory_limit, score FROM problem_test_cases WHERE problem_id = ?;";
+    std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement(query));
     pstmt->setInt(1, problemId);
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json hints = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json hint;
-        hint["title"] = res->getString("title");
-        hint["hint"] = res->getString("hint");
-        hints.push_back(hint);
-    }
-    return hints;
+    return mapper.map(*res);
 }
 
 nlohmann::json get_problem_submissions(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT * FROM problem_submissions WHERE problem_id = ? ORDER BY submission_time DESC;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
+    static const RowMapper mapper({
+        {"id", RowMapper::Type::Int},
+        {"user_id", RowMapper::Type::Int},
+        {"submission_time", RowMapper::Type::String},
+        {"code", RowMapper::Type::String},
+        {"status", RowMapper::Type::String},
+        {"time_taken", RowMapper::Type::Int},
+        {"memory_taken", RowMapper::Type::Int},
+        {"language", RowMapper::Type::String}
+    });
+    std::string query = "SELECT id, user_id, submission_time, code, status, time_taken, memory_taken, language FROM problem_submissions WHERE problem_id = ? ORDER BY submission_time DESC;";
+    std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement(query));
     pstmt->setInt(1, problemId);
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json submissions = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json submission;
-        submission["id"] = res->getInt("id");
-        submission["user_id"] = res->getInt("user_id");
-        submission["submission_time"] = res->getString("submission_time");
-        submission["code"] = res->getString("code");
-        submission["status"] = res->getString("status");
-        submission["time_taken"] = res->getInt("time_taken");
-        submission["memory_taken"] = res->getInt("memory_taken");
-        submission["language"] = res->getString("language");
-        submissions.push_back(submission);
-    }
-    return submissions;
+    return mapper.map(*res);
 }
 
 nlohmann::json get_problem_submissions_subtasks(std::unique_ptr<APIs>& sqlAPI, int submissionId) {
-    std::string query = "SELECT * FROM problem_submissions_subtasks WHERE submission_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
+    static const RowMapper mapper({
+        {"submission_id", RowMapper::Type::Int},
+        {"id", RowMapper::Type::Int},
+        {"status", RowMapper::Type::String},
+        {"time_taken", RowMapper::Type::Int},
+        {"memory_taken", RowMapper::Type::Int}
+    });
+    std::string query = "SELECT submission_id, id, status, time_taken, memory_taken FROM problem_submissions_subtasks WHERE submission_id = ?;";
+    std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement(query));
     pstmt->setInt(1, submissionId);
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json subtasks = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json subtask;
-        subtask["submission_id"] = res->getInt("submission_id");
-        subtask["id"] = res->getInt("id");
-        subtask["status"] = res->getString("status");
-        subtask["time_taken"] = res->getInt("time_taken");
-        subtask["memory_taken"] = res->getInt("memory_taken");
-        subtasks.push_back(subtask);
-    }
-    return subtasks;
-}
-
-nlohmann::json get_problem_roles(std::unique_ptr<APIs>& sqlAPI, int problemId) {
-    std::string query = "SELECT rp.name, rp.color, pr.permission_flags "
-                        "FROM problem_role pr "
-                        "JOIN roles_problem rp ON pr.role_name = rp.name "
-                        "WHERE pr.problem_id = ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-    pstmt->setInt(1, problemId);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    nlohmann::json roles = nlohmann::json::array();
-    while (res->next()) {
-        nlohmann::json role;
-        role["name"] = res->getString("name");
-        role["color"] = res->getString("color");
-        role["permission_flags"] = res->getInt("permission_flags");
-        roles.push_back(role);
-    }
-    return roles;
+    return mapper.map(*res);
 }
 
 } // namespace
 
-void ROUTE_problem(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& sqlAPI, cache::lru_cache<int16_t, nlohmann::json>& problem_cache){
+void ROUTE_problem(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<DBExecutor>& executor, cache::lru_cache<int, nlohmann::json>& problem_cache, PermissionIndex& permission_index){
     CROW_ROUTE(app, "/problem/<int>")
     .methods("GET"_method)
-    ([&settings, IP, &sqlAPI, &problem_cache](const crow::request& req, int problemId){
-        nlohmann::json roles;
-        try {
-            std::string jwt = req.get_header_value("Authorization");
-            if (jwt != "null") {
-                JWT::verifyJWT(jwt, settings, IP);
-                roles = JWT::getRoles(jwt);
-            }
-        } catch (const std::exception& e) {
-        }
-        nlohmann::json problem_roles = get_problem_roles(sqlAPI, problemId);
-        //permission check
-        if(!have_permission(settings, "view", roles, problem_roles)){
-            return crow::response(403, "Permission denied");
+    ([&settings, &app, &sqlAPI, &executor, &problem_cache, &permission_index](const crow::request& req, crow::response& response, int problemId){
+        QueryStats::Route route("/problem/<int>");
+        const AuthContext& auth = authOf(app, req);
+
+        // anonymous visitors see what the "everyone" role sees
+        static const uint32_t everyone = RoleNames::intern("everyone");
+        std::vector<uint32_t> roles = auth.authenticated ? auth.roles : std::vector<uint32_t>{everyone};
+        bool admin = auth.isSiteAdmin();
+        //permission check, before any query
+        if(!admin && !have_permission(settings, "view", permission_index, problemId, roles)){
+            response = crow::response(403, "Permission denied");
+            response.end();
+            return;
         }
-        //do a cache hit
-        if(problem_cache.exists(problemId)){
-            nlohmann::json problem = problem_cache.get(problemId);
-            if(!have_permission(settings, "view_solutions", roles, problem_roles))
+        bool viewSolutions = admin || have_permission(settings, "view_solutions", permission_index, problemId, roles);
+
+        respondAsync(*executor, response, [&sqlAPI, &problem_cache, userId = auth.authenticated ? std::optional<int>(auth.user_id) : std::nullopt, problemId, viewSolutions]() {
+            std::unique_ptr<APIs::ReadYourWrites> readYourWrites;
+            if (userId) {
+                readYourWrites = std::make_unique<APIs::ReadYourWrites>(*sqlAPI, *userId);
+            }
+            nlohmann::json problem;
+            //do a cache hit
+            if(std::optional<nlohmann::json> cached = problem_cache.try_get(problemId)){
+                problem = std::move(*cached);
+            } else {
+                // taken before the load, so an edit committed meanwhile keeps this copy out of the cache
+                uint64_t generation = problem_cache.generation(problemId);
+                try {
+                    problem = get_problem_detail(sqlAPI, problemId);
+                } catch (const std::exception& e) {
+                    return crow::response(404, e.what());
+                }
+                problem_cache.put_if_current(problemId, problem, generation);
+            }
+            if(!viewSolutions)
                 problem.erase("solutions");
-            return crow::response(200, problem_cache.get(problemId));
-        }
-        nlohmann::json problem;
-        try {
-            problem = get_problem(sqlAPI, problemId);
-            problem["sample_io"] = get_problem_sample_IO(sqlAPI, problemId);
-            problem["tags"] = get_problem_tags(sqlAPI, problemId);
-            problem["hints"] = get_problem_hints(sqlAPI, problemId);
-            if(have_permission(settings, "view_solutions", roles, problem_roles))
-                problem["solutions"] = get_problem_solution(sqlAPI, problemId);
-            
-        } catch (const std::exception& e) {
-            return crow::response(404, e.what());
-        }
+            return crow::response(200, problem.dump());
+        });
     });
 }
\ No newline at end of file
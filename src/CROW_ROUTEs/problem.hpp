@@ -8,8 +8,11 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../include/lrucache.hpp"
 #include "../API/api.hpp"
+#include "../API/db_executor.hpp"
+#include "../API/permission_index.hpp"
 
 namespace {
 /**
@@ -50,6 +53,8 @@ bool view_solutions_permission(nlohmann::json& settings, nlohmann::json& roles,
  * @param settings JSON object containing configuration settings, used for JWT verification and role-based access control.
  * @param IP String representing the IP address for additional security checks in JWT verification.
  * @param sqlAPI Unique pointer to an APIs instance, used for database operations.
- * @param problem_cache Reference to an LRU cache instance for caching problem details.
+ * @param executor Unique pointer to the DBExecutor the handler runs on, so the Crow worker thread is not blocked by the queries.
+ * @param problem_cache LRU cache of problem details by id; the manage panel erases a problem from it when the problem is created, edited or deleted, and a load racing that erase is not stored.
+ * @param permission_index Answers the view and view_solutions checks without a query.
  */
-void ROUTE_problem(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& sqlAPI, cache::lru_cache<int16_t, nlohmann::json>& problem_cache);
\ No newline at end of file
+void ROUTE_problem(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<DBExecutor>& executor, cache::lru_cache<int, nlohmann::json>& problem_cache, PermissionIndex& permission_index);
\ No newline at end of file
@@ -3,65 +3,60 @@
  * @brief Implementation of the problems route.
  */
 #include "problems.hpp"
+#include "async_response.hpp"
+#include "../API/row_mapper.hpp"
 #include "../Programs/jwt.hpp"
+#include "../Programs/cursor.hpp"
 
 #include <jwt-cpp/jwt.h>
+#include <algorithm>
 
 crow::response JSON_RES(int code, const std::string& message) {
     return crow::response(code, "{\"message\": \"" + message + "\"}");
 }
 namespace {
-nlohmann::json getProblems(std::unique_ptr<APIs>& API, std::vector<std::string> roles, int problemsPerPage, int offset) {
-    nlohmann::json problems;
-    std::string query = "SELECT problems.* FROM problems JOIN problem_role ON problems.id = problem_role.problem_id WHERE problem_role.role_name IN (";
-    int i = 0;
-    for (const std::string& role : roles) {
-        query += "?";
-        if (i < roles.size() - 1) {
-            query += ", ";
-        }
-        i++;
+// with afterId set, offset is ignored and the page starts after that id (keyset pagination)
+nlohmann::json getProblems(std::unique_ptr<APIs>& API, std::vector<std::string> roles, int problemsPerPage, int offset, std::optional<int64_t> afterId) {
+    std::string query = "SELECT DISTINCT problems.id, problems.title, problems.difficulty FROM problems JOIN problem_role ON problems.id = problem_role.problem_id WHERE problem_role.role_name IN (";
+    query += APIs::inPlaceholders(roles.size());
+    query += ")";
+    if (afterId) {
+        query += " AND problems.id > ?";
     }
-    query += ") LIMIT ? OFFSET ?;";
-    std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
-    for (i = 0; i < roles.size(); i++) {
-        pstmt->setString(i + 1, roles[i]);
+    query += " ORDER BY problems.id LIMIT ?";
+    if (!afterId) {
+        query += " OFFSET ?";
     }
-    pstmt->setInt(roles.size() + 1, problemsPerPage);
-    pstmt->setInt(roles.size() + 2, offset);
-    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-    while (res->next()) {
-        nlohmann::json problem;
-        problem["id"] = res->getInt("id");
-        problem["title"] = res->getString("title");
-        problem["difficulty"] = res->getString("difficulty");
-        problems.push_back(problem);
+    query += ";";
+    std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query, APIs::Access::Read));
+    unsigned int next = pstmt->setStringList(1, roles);
+    if (afterId) {
+        pstmt->setInt64(next++, *afterId);
+    }
+    pstmt->setInt(next++, problemsPerPage);
+    if (!afterId) {
+        pstmt->setInt(next, offset);
     }
-    return problems;
+    static const RowMapper mapper({
+        {"id", RowMapper::Type::Int},
+        {"title", RowMapper::Type::String},
+        {"difficulty", RowMapper::Type::String}
+    });
+    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+    return mapper.map(*res);
 }
 
 int64_t getProblemsCount(std::unique_ptr<APIs>& API, const std::vector<std::string>& roles) {
     int result;
     try {
-        std::string query = R"(
-            SELECT COUNT(DISTINCT pr.problem_id) AS problem_count
-            FROM users u
-            JOIN user_roles ur ON u.id = ur.user_id
-            JOIN problem_role pr ON ur.role_name = pr.role_name
-            WHERE ur.role_name IN ( )";
-        
-        for (size_t i = 0; i < roles.size(); ++i) {
-            query += "?";
-            if (i < roles.size() - 1) {
-                query += ", ";
-            }
-        }
+        // same visibility rule as getProblems, so the count matches the listed pages
+        std::string query = "SELECT COUNT(DISTINCT problem_id) AS problem_count FROM problem_role WHERE role_name IN (";
+        query += APIs::inPlaceholders(roles.size());
         query += ")";
 
-        std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
-        for (size_t i = 0; i < roles.size(); ++i) {
-            pstmt->setString(i + 1, roles[i]);
-        }
+        // read from the primary: the count stays in problem_counters until the next manage panel write
+        std::unique_ptr<PooledStatement> pstmt(API->prepareStatement(query));
+        pstmt->setStringList(1, roles);
 
         std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
         if (res->next()) {
@@ -77,60 +72,86 @@ int64_t getProblemsCount(std::unique_ptr<APIs>& API, const std::vector<std::stri
 }
 }//namespace
 
-void ROUTE_problems(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, cache::lru_cache<int8_t, nlohmann::json>& problems_everyone_cache, std::atomic<bool>& problems_everyone_cache_hit){
+void ROUTE_problems(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<DBExecutor>& executor, ProblemCounters& problem_counters, cache::lru_cache<int8_t, nlohmann::json>& problems_everyone_cache, std::atomic<bool>& problems_everyone_cache_hit){
     CROW_ROUTE(app, "/problems")
     .methods("GET"_method)
-    ([&settings, IP, &API, &problems_everyone_cache, &problems_everyone_cache_hit](const crow::request& req){
-        nlohmann::json roles;
-        try {
-            std::string jwt = req.get_header_value("Authorization");
-            if (jwt != "null") {
-                JWT::verifyJWT(jwt, settings, IP);
-                roles = JWT::getRoles(jwt);
+    ([&settings, &app, &API, &executor, &problem_counters, &problems_everyone_cache, &problems_everyone_cache_hit](const crow::request& req, crow::response& response){
+        QueryStats::Route route("/problems");
+        // the request is not available on the executor thread
+        AuthContext auth = authOf(app, req);
+        const char* pageParam = req.url_params.get("page");
+        const char* problemsPerPageParam = req.url_params.get("problemsPerPage");
+        const char* afterParam = req.url_params.get("after");
+        std::string pageValue = pageParam ? pageParam : "";
+        std::string problemsPerPageValue = problemsPerPageParam ? problemsPerPageParam : "";
+        std::string afterValue = afterParam ? afterParam : "";
+
+        respondAsync(*executor, response, [&settings, &API, &problem_counters, &problems_everyone_cache, &problems_everyone_cache_hit, auth = std::move(auth), pageValue, problemsPerPageValue, afterValue]() {
+            std::vector<std::string> roleNames;
+            std::unique_ptr<APIs::ReadYourWrites> readYourWrites;
+            if (auth.authenticated) {
+                roleNames = auth.roleNames();
+                readYourWrites = std::make_unique<APIs::ReadYourWrites>(*API, auth.user_id);
+            }
+            if (roleNames.empty()) {
+                roleNames = {"everyone"};
+            }
+            // check problems count
+            int64_t problemsCount = problem_counters.get(ProblemCounters::Scope::View, roleNames, [&API, &roleNames]() {
+                return getProblemsCount(API, roleNames);
+            });
+            if(problemsCount == -1) {
+                return JSON_RES(500, "Internal Server Error");
+            }
+            if (problemsCount == 0) {
+                return JSON_RES(204, "No problems found.");
             }
-        } catch (const std::exception& e) {
-            roles = {"everyone"};
-        }
-        // check problems count
-        int64_t problemsCount = getProblemsCount(API, roles);
-        if(problemsCount == -1) {
-            return JSON_RES(500, "Internal Server Error");
-        }
-        if (problemsCount == 0) {
-            return JSON_RES(204, "No problems found.");
-        }
 
-        // Handle page query parameter
-        u_int32_t page = 1, problemsPerPage = 10;
-        if (req.url_params.get("page")) {
-            page = std::stoi(req.url_params.get("page"));
-        }
-        if (req.url_params.get("problemsPerPage")) {
-            problemsPerPage = std::stoi(req.url_params.get("problemsPerPage"));
-        }
-        u_int32_t offset = (page - 1) * problemsPerPage;
+            // Handle page query parameter
+            u_int32_t page = 1, problemsPerPage = 10;
+            if (!pageValue.empty()) {
+                page = std::stoi(pageValue);
+            }
+            if (!problemsPerPageValue.empty()) {
+                problemsPerPage = std::stoi(problemsPerPageValue);
+            }
+            problemsPerPage = std::clamp<u_int32_t>(problemsPerPage, 1, settings.value("max_problems_per_page", 100));
+            u_int32_t offset = (page - 1) * problemsPerPage;
+            std::optional<int64_t> afterId;
+            if (!afterValue.empty()) {
+                afterId = Cursor::decode(afterValue);
+                if (!afterId) {
+                    return JSON_RES(400, "Invalid cursor.");
+                }
+            }
 
-        nlohmann::json problems;
+            nlohmann::json problems;
 
-        if (roles.size()>1 || (offset+problemsPerPage > problems_everyone_cache.size() && problems_everyone_cache_hit)) {
-            problems = getProblems(API, roles, problemsPerPage, offset);
-        } else if(!problems_everyone_cache_hit) {
-            problems = getProblems(API, roles, problemsPerPage, offset);
-            if(!problems.empty()) {
-                problems_everyone_cache_hit = true;
-                for (const auto& problem : problems) {
-                    problems_everyone_cache.put(problem["id"], problem);
+            if (afterId) {
+                problems = getProblems(API, roleNames, problemsPerPage, 0, afterId);
+            } else if (roleNames.size()>1 || (offset+problemsPerPage > problems_everyone_cache.size() && problems_everyone_cache_hit)) {
+                problems = getProblems(API, roleNames, problemsPerPage, offset, std::nullopt);
+            } else if(!problems_everyone_cache_hit) {
+                problems = getProblems(API, roleNames, problemsPerPage, offset, std::nullopt);
+                if(!problems.empty()) {
+                    problems_everyone_cache_hit = true;
+                    for (const auto& problem : problems) {
+                        problems_everyone_cache.put(problem["id"], problem);
+                    }
+                }
+            } else {
+                for (int i = offset; i < offset + problemsPerPage; i++) {
+                    problems.push_back(problems_everyone_cache.get(i));
                 }
             }
-        } else {
-            for (int i = offset; i < offset + problemsPerPage; i++) {
-                problems.push_back(problems_everyone_cache.get(i));
+            nlohmann::json res;
+            res["problems"] = problems;
+            res["problemsCount"] = problemsCount;
+            if (problems.is_array() && problems.size() == problemsPerPage && problems.back().contains("id")) {
+                res["next"] = Cursor::encode(problems.back()["id"].get<int64_t>());
             }
-        }
-        nlohmann::json res;
-        res["problems"] = problems;
-        res["problemsCount"] = problemsCount;
 
-        return crow::response(200, res.dump());
+            return crow::response(200, res.dump());
+        });
     });
 }
\ No newline at end of file
@@ -7,26 +7,33 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include <optional>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
+#include "../API/db_executor.hpp"
 #include "../include/lrucache.hpp"
+#include "../Programs/problem_counters.hpp"
 
 namespace {
-nlohmann::json getProblems(std::unique_ptr<APIs>& API, std::vector<std::string> roles, int problemsPerPage, int offset);
+nlohmann::json getProblems(std::unique_ptr<APIs>& API, std::vector<std::string> roles, int problemsPerPage, int offset, std::optional<int64_t> afterId);
 int64_t getProblemsCount(std::unique_ptr<APIs>& API, const std::vector<std::string>& roles);
 }
 
 /**
  * @brief Configures a route for accessing a list of problems.
  * 
- * This function sets up a route "/problems" on the provided Crow application instance. It handles GET requests to fetch a list of problems, supporting pagination and role-based filtering. The function performs JWT verification, role extraction, and conditionally queries the database or cache based on the roles and pagination parameters.
+ * This function sets up a route "/problems" on the provided Crow application instance. It handles GET requests to fetch a list of problems, supporting pagination and role-based filtering.
+ * Pages are requested either with the opaque `after` cursor returned as `next` by the previous page (keyset pagination), or with the legacy `page` parameter. `problemsPerPage` is capped by the `max_problems_per_page` setting. The function performs JWT verification, role extraction, and conditionally queries the database or cache based on the roles and pagination parameters.
  * 
  * @param app Reference to the Crow application instance configured with CORSHandler middleware.
  * @param settings JSON object containing configuration settings, used for JWT verification and role-based access control.
  * @param IP String representing the IP address for additional security checks in JWT verification.
  * @param API Unique pointer to an APIs instance, used for database operations.
+ * @param executor Unique pointer to the DBExecutor the handler runs on, so the Crow worker thread is not blocked by the queries.
+ * @param problem_counters Cache of the problem count per role set, so listing pages do not run a COUNT per request.
  * @param problems_everyone_cache Reference to an LRU cache instance for caching problems accessible to everyone.
  * @param problems_everyone_cache_hit Atomic boolean flag indicating whether the cache for problems accessible to everyone has been populated.
  * 
  * The function begins by verifying the JWT from the request header and extracting roles. It then processes query parameters for pagination. Based on the roles and pagination, it either queries the database for problems or retrieves them from the cache. The function supports a special case where problems accessible to everyone are cached to improve performance. It returns a JSON response with the list of problems or an error message if no problems are found.
  */
-void ROUTE_problems(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, cache::lru_cache<int8_t, nlohmann::json>& problems_everyone_cache, std::atomic<bool>& problems_everyone_cache_hit);
\ No newline at end of file
+void ROUTE_problems(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API, std::unique_ptr<DBExecutor>& executor, ProblemCounters& problem_counters, cache::lru_cache<int8_t, nlohmann::json>& problems_everyone_cache, std::atomic<bool>& problems_everyone_cache_hit);
\ No newline at end of file
@@ -1,7 +1,7 @@
 // #include "profile.hpp"
 // #include "../Programs/jwt.hpp"
 
-// void ROUTE_profile(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API){
+// void ROUTE_profile(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API){
 //     CROW_ROUTE(app, "/profile/<int>")
 //     .methods("GET"_method)
 //     ([&](const crow::request& req, crow::response& res, int userId){
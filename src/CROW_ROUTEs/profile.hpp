@@ -3,4 +3,4 @@
 // #include <nlohmann/json.hpp>
 // #include "../API/api.hpp"
 
-// void ROUTE_profile(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API);
\ No newline at end of file
+// void ROUTE_profile(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& API);
\ No newline at end of file
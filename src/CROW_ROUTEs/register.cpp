@@ -1,12 +1,12 @@
 
 #include "register.hpp"
 
+#include "async_response.hpp"
 #include "../Programs/jwt.hpp"
 
 #include <cppconn/resultset.h>
 #include <cppconn/prepared_statement.h>
 #include <vmime/vmime.hpp>
-#include <bcrypt/BCrypt.hpp>
 
 namespace{
 IPrateLimit::IPrateLimit(std::string email = "") {
@@ -47,93 +47,106 @@ bool RateLimit::check_rate_limit(std::string ip, std::string email) {
 
 RateLimit rateLimit;
 
-void ROUTE_Register(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& api) {
+void ROUTE_Register(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& api, std::unique_ptr<DBExecutor>& executor, std::unique_ptr<PasswordHasher>& hasher) {
     CROW_ROUTE(app, "/register")
     .methods("POST"_method)
-    ([&settings, IP, &api](const crow::request& req){
-        nlohmann::json body = nlohmann::json::parse(req.body);
+    ([&settings, IP, &api, &executor, &hasher](const crow::request& req, crow::response& response){
+        QueryStats::Route route("/register");
+        nlohmann::json body = nlohmann::json::parse(req.body, nullptr, false);
+        if (!body.is_object() || !body["name"].is_string() || !body["email"].is_string() || !body["password"].is_string()) {
+            respondNow(response, crow::response(400, "{\"error\": \"Missing name, email or password\"}"));
+            return;
+        }
 
         // rate limiting
         if (!rateLimit.check_rate_limit(req.remote_ip_address, body["email"].get<std::string>())) {
-            crow::response res(429, "{\"error\": \"Too many requests\"}");
-            return res;
+            respondNow(response, crow::response(429, "{\"error\": \"Too many requests\"}"));
+            return;
         }
 
-        int new_tag = 0;
-        int user_id = 0;
-        try {
-            // tag selection
-            std::string query = "SELECT COALESCE(MAX(tag), 0) + 1 AS new_tag FROM users WHERE name = ?;";
-            std::unique_ptr<sql::PreparedStatement> pstmt = api->prepareStatement(query);
-            pstmt->setString(1, body["name"].get<std::string>());
-            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-            if (res->next()) {
-                new_tag = res->getInt("new_tag");
+        // hash password using bcrypt on a hashing thread, then store the user on a database thread
+        // library url: https://github.com/trusch/libbcrypt
+        std::string password = body["password"].get<std::string>();
+        bool hashing = hasher->hash(password, [&settings, IP, &api, &executor, &response, body = std::move(body), routeName = QueryStats::currentRoute()](const std::string& hashed_password) {
+            if (hashed_password.empty()) {
+                respondNow(response, crow::response(500));
+                return;
             }
-            // check email uniqueness
-            query = "SELECT COUNT(*) AS count FROM users WHERE email = ?;";
-            pstmt = api->prepareStatement(query);
-            pstmt->setString(1, body["email"].get<std::string>());
-            res = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
-            if (res->next()) {
-                if (res->getInt("count") > 0) {
-                    crow::response res(400, "{\"error\": \"Email already in use\"}");
-                    return res;
+            QueryStats::Route route(routeName);
+            respondAsync(*executor, response, [&settings, IP, &api, body, hashed_password] {
+                int new_tag = 0;
+                int user_id = 0;
+                try {
+                    // tag selection
+                    std::string query = "SELECT COALESCE(MAX(tag), 0) + 1 AS new_tag FROM users WHERE name = ?;";
+                    std::unique_ptr<PooledStatement> pstmt = api->prepareStatement(query);
+                    pstmt->setString(1, body["name"].get<std::string>());
+                    std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+                    if (res->next()) {
+                        new_tag = res->getInt("new_tag");
+                    }
+                    // check email uniqueness
+                    query = "SELECT COUNT(*) AS count FROM users WHERE email = ?;";
+                    pstmt = api->prepareStatement(query);
+                    pstmt->setString(1, body["email"].get<std::string>());
+                    res = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
+                    if (res->next()) {
+                        if (res->getInt("count") > 0) {
+                            return crow::response(400, "{\"error\": \"Email already in use\"}");
+                        }
+                    }
+
+                    // check email ownership using vmime
+                    /*
+                        need to be implemented
+
+                        possable solution:
+                            1. gmail/sendgrid SMTP
+                            2. local SMTP server
+                    */
+
+                    // insert user
+                    query = "INSERT INTO users (name, tag, email, password) VALUES (?, ?, ?, ?);";
+                    pstmt = api->prepareStatement(query);
+                    pstmt->setString(1, body["name"].get<std::string>());
+                    pstmt->setInt(2, new_tag);
+                    pstmt->setString(3, body["email"].get<std::string>());
+                    pstmt->setString(4, hashed_password);
+                    pstmt->executeUpdate();
+
+                    //get user_id
+                    query = "SELECT id FROM users WHERE email = ?;";
+                    pstmt = api->prepareStatement(query);
+                    pstmt->setString(1, body["email"].get<std::string>());
+                    res = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
+                    if (res->next()) {
+                        user_id = res->getInt("id");
+                    } else {
+                        return crow::response(500);
+                    }
+
+                } catch (sql::SQLException &e) {
+                    CROW_LOG_ERROR << "SQL Exception in " << __FILE__;
+                    CROW_LOG_ERROR << "(" << __FUNCTION__ << ") on line " << __LINE__;
+                    CROW_LOG_ERROR << "Error: " << e.what();
+                    CROW_LOG_ERROR << " (MySQL error code: " << e.getErrorCode();
+                    CROW_LOG_ERROR << ", SQLState: " << e.getSQLState() << ")";
+                    return crow::response(500);
+                } catch (std::exception &e) {
+                    CROW_LOG_ERROR << "Exception in " << __FILE__;
+                    CROW_LOG_ERROR << "(" << __FUNCTION__ << ") on line " << __LINE__;
+                    CROW_LOG_ERROR << "Error: " << e.what();
+                    return crow::response(500);
                 }
-            }
-
-            // check email ownership using vmime
-            /*
-                need to be implemented
-
-                possable solution:
-                    1. gmail/sendgrid SMTP
-                    2. local SMTP server
-            */
-
-            // hash password using bcrypt
-            // library url: https://github.com/trusch/libbcrypt
-            std::string hashed_password = BCrypt::generateHash(body["password"].get<std::string>());
-
-            // insert user
-            query = "INSERT INTO users (name, tag, email, password) VALUES (?, ?, ?, ?);";
-            pstmt = api->prepareStatement(query);
-            pstmt->setString(1, body["name"].get<std::string>());
-            pstmt->setInt(2, new_tag);
-            pstmt->setString(3, body["email"].get<std::string>());
-            pstmt->setString(4, hashed_password);
-            pstmt->executeUpdate();
-
-            //get user_id
-            query = "SELECT id FROM users WHERE email = ?;";
-            pstmt = api->prepareStatement(query);
-            pstmt->setString(1, body["email"].get<std::string>());
-            res = std::unique_ptr<sql::ResultSet>(pstmt->executeQuery());
-            if (res->next()) {
-                user_id = res->getInt("id");
-            } else {
-                crow::response res(500);
-                return res;
-            }
 
-        } catch (sql::SQLException &e) {
-            CROW_LOG_ERROR << "SQL Exception in " << __FILE__;
-            CROW_LOG_ERROR << "(" << __FUNCTION__ << ") on line " << __LINE__;
-            CROW_LOG_ERROR << "Error: " << e.what();
-            CROW_LOG_ERROR << " (MySQL error code: " << e.getErrorCode();
-            CROW_LOG_ERROR << ", SQLState: " << e.getSQLState() << ")";
-            crow::response res(500);
-            return res;
-        } catch (std::exception &e) {
-            CROW_LOG_ERROR << "Exception in " << __FILE__;
-            CROW_LOG_ERROR << "(" << __FUNCTION__ << ") on line " << __LINE__;
-            CROW_LOG_ERROR << "Error: " << e.what();
-            crow::response res(500);
-            return res;
+                nlohmann::json res;
+                res["JWT"] = JWT::generateJWT(settings, IP, user_id, api);
+                res["name"] = body["name"];
+                return crow::response(200, res.dump());
+            });
+        });
+        if (!hashing) {
+            respondNow(response, crow::response(503, R"({"error": "Server busy, try again later"})"));
         }
-
-        std::string token = JWT::generateJWT(settings, IP, user_id, api);
-        crow::response res(200, "{\"JWT\": \"" + token + "\", \"name\": \"" + body["name"].get<std::string>() + "\"}");
-        return res;
     });
-}
\ No newline at end of file
+}
@@ -7,7 +7,10 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
+#include "../API/db_executor.hpp"
+#include "../Programs/password_hasher.hpp"
 
 /**
  * @class IPrateLimit
@@ -79,7 +82,9 @@ private:
  * @param settings Reference to a JSON object containing application settings.
  * @param IP String representing the client's IP address, used for logging.
  * @param api Unique pointer to the APIs object, facilitating database interactions.
+ * @param executor Runs the queries, so the Crow worker thread is not blocked.
+ * @param hasher Hashes the password on its own threads; the route answers 503 when its queue is full.
  * 
  * @attention Email ownership verification should be implemented to prevent unauthorized registrations.
  */
-void ROUTE_Register(crow::App<crow::CORSHandler>& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& api);
\ No newline at end of file
+void ROUTE_Register(CrowApp& app, nlohmann::json& settings, std::string IP, std::unique_ptr<APIs>& api, std::unique_ptr<DBExecutor>& executor, std::unique_ptr<PasswordHasher>& hasher);
\ No newline at end of file
@@ -0,0 +1,77 @@
+#include "submission_stream.hpp"
+
+#include <unordered_map>
+
+namespace {
+// submissions one connection may follow at once
+constexpr size_t max_subscriptions = 32;
+
+// the subscription of each followed submission, ended when the connection closes
+using Subscriptions = std::unordered_map<int64_t, uint64_t>;
+
+void sendError(crow::websocket::connection& conn, const nlohmann::json& submission_id, const std::string& message) {
+    conn.send_text(nlohmann::json({{"submission_id", submission_id}, {"error", message}}).dump());
+}
+}//namespace
+
+void ROUTE_SubmissionStream(CrowApp& app, nlohmann::json& settings, std::string IP, VerdictHub& hub) {
+    CROW_WEBSOCKET_ROUTE(app, "/submissions/stream")
+    .onopen([](crow::websocket::connection& conn) {
+        conn.userdata(new Subscriptions());
+    })
+    .onclose([&hub](crow::websocket::connection& conn, const std::string& reason, uint16_t code) {
+        auto* subscriptions = static_cast<Subscriptions*>(conn.userdata());
+        // after unsubscribe() no judge worker can still be sending on this connection
+        for (const auto& entry : *subscriptions) {
+            hub.unsubscribe(entry.second);
+        }
+        delete subscriptions;
+        conn.userdata(nullptr);
+    })
+    .onmessage([&app, &hub](crow::websocket::connection& conn, const std::string& data, bool is_binary) {
+        nlohmann::json message = nlohmann::json::parse(data, nullptr, false);
+        if (!message.is_object() || !message["token"].is_string() || !message["submission_id"].is_number_integer()) {
+            sendError(conn, nullptr, "Expected {\"token\", \"submission_id\"}");
+            return;
+        }
+        int64_t submission_id = message["submission_id"].get<int64_t>();
+        // websocket messages do not go through before_handle, so the token is checked the same way here
+        AuthContext auth = app.get_middleware<AuthMiddleware>().authenticate(message["token"].get<std::string>());
+        if (!auth.authenticated) {
+            sendError(conn, submission_id, "Unauthorized");
+            return;
+        }
+        auto& subscriptions = *static_cast<Subscriptions*>(conn.userdata());
+        if (subscriptions.count(submission_id)) {
+            sendError(conn, submission_id, "Already subscribed");
+            return;
+        }
+        if (subscriptions.size() >= max_subscriptions) {
+            // the hub drops the subscriptions of closed submissions; forget those before refusing
+            for (auto it = subscriptions.begin(); it != subscriptions.end();) {
+                it = hub.owner(it->first) ? std::next(it) : subscriptions.erase(it);
+            }
+            if (subscriptions.size() >= max_subscriptions) {
+                sendError(conn, submission_id, "Too many subscriptions");
+                return;
+            }
+        }
+        std::optional<int> owner = hub.owner(submission_id);
+        if (!owner) {
+            sendError(conn, submission_id, "Submission is not being judged");
+            return;
+        }
+        if (*owner != auth.user_id && !auth.isSiteAdmin()) {
+            sendError(conn, submission_id, "Permission denied");
+            return;
+        }
+        std::optional<uint64_t> subscription = hub.subscribe(submission_id, [&conn](const nlohmann::json& event) {
+            conn.send_text(event.dump());
+        });
+        if (!subscription) {
+            sendError(conn, submission_id, "Submission is not being judged");
+            return;
+        }
+        subscriptions.emplace(submission_id, *subscription);
+    });
+}
@@ -0,0 +1,27 @@
+#pragma once
+#include <crow.h>
+#include <crow/middlewares/cors.h>
+#include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
+#include "../API/verdict_hub.hpp"
+#include "../Programs/jwt.hpp"
+
+/**
+ * @brief Configures the "/submissions/stream" websocket.
+ *
+ * Pushes the progress of submissions instead of having clients poll for it. After connecting, the
+ * client sends {"token": <JWT>, "submission_id": <id>} for every submission it wants to follow;
+ * the token is sent in the message because browsers cannot set headers on a websocket. The
+ * submitter or a site admin then receives the events already published for that submission
+ * followed by the live ones, each a JSON object with "submission_id" and "type":
+ *   - "judging": a judge worker took the submission.
+ *   - "test_case": the verdict of one test case, with "id", "status", "time_taken" and "memory_taken".
+ *   - "verdict": the final "status", "score", "time_taken" and "memory_taken"; nothing follows.
+ * A subscription that cannot be made is answered with {"submission_id", "error"}; a submission
+ * that is no longer queued or being judged has its result stored already. The token is checked
+ * through AuthMiddleware and its TokenCache like any other request. A connection follows at most
+ * 32 submissions at once and each only once.
+ *
+ * @param hub The hub the judge workers publish to.
+ */
+void ROUTE_SubmissionStream(CrowApp& app, nlohmann::json& settings, std::string IP, VerdictHub& hub);
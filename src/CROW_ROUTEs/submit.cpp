@@ -1,152 +1,148 @@
 #include "submit.hpp"
-#include "../API/sand_box_api.hpp"
 
-#define JSON_ERROR(message) nlohmann::json({{"error", message}})
+#define JSON_ERROR(message) nlohmann::json({{"error", message}}).dump()
 
-void ROUTE_Submit(crow::App<crow::CORSHandler>& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<APIs>& submissionAPI, std::vector<std::string> accepted_languages, std::unique_ptr<sand_box_api>& sandboxAPI) {
+void ROUTE_Submit(CrowApp& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::vector<std::string>& accepted_languages, std::unique_ptr<JudgeQueue>& judgeQueue, PermissionIndex& permission_index) {
     CROW_ROUTE(app, "/submit")
     .methods("POST"_method)
-    ([&](const crow::request& req){
-        // Parse the request body
-        nlohmann::json body = nlohmann::json::parse(req.body);
-        // // Check permissions
-        // std::string jwt = req.get_header_value("Authorization");
-        // try {
-        //     JWT::verifyJWT(jwt, settings, IP);
-        // } catch (const std::exception& e) {
-        //     return crow::response(401, JSON_ERROR(e.what()));
-        // }
-        // try {
-        //     if(!JWT::isPermissioned(jwt, body["problem_id"].get<int>(), sqlAPI, settings["permission_flags"]["submit"].get<int>())){
-        //         return crow::response(403, JSON_ERROR("Permission denied"));
-        //     }
-        // } catch (const std::exception& e) {
-        //     return crow::response(500, JSON_ERROR(e.what()));
-        // }
+    ([&settings, &app, &sqlAPI, &accepted_languages, &judgeQueue, &permission_index](const crow::request& req){
+        QueryStats::Route route("/submit");
+        // Check permissions
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, JSON_ERROR(auth.error.empty() ? "Missing token" : auth.error));
+        }
+        APIs::ReadYourWrites readYourWrites(*sqlAPI, auth.user_id);
 
-        // // Validate the request body
-        // if (!body.contains("source_code") || !body.contains("language") || !body.contains("problem_id")) {
-        //     return crow::response(400, JSON_ERROR("Missing required fields"));
-        // }
-        // // Get the source code, language, and problem ID
-        // std::string source_code = body["source_code"].get<std::string>();
-        // std::string language = body["language"].get<std::string>();
-        // int problem_id = body["problem_id"].get<int>();
-        // // Validate the language
-        // if (std::find(accepted_languages.begin(), accepted_languages.end(), language) == accepted_languages.end()) {
-        //     return crow::response(400, JSON_ERROR("Invalid language"));
-        // }
-        // int submission_id;
-        // // insert the submission and mark it as pending
-        // try {
-        //     std::string query = "INSERT INTO problem_submissions (problem_id, user_id, submission_time, code, score, status, time_taken, memory_taken, language) VALUES (?, ?, NOW(), ?, ?, ?, ?, ?, ?);";
-        //     submissionAPI->beginTransaction();
-        //     std::unique_ptr<sql::PreparedStatement> pstmt(submissionAPI->prepareStatement(query));
-        //     pstmt->setInt(1, problem_id);
-        //     pstmt->setInt(2, JWT::getUserID(jwt));
-        //     pstmt->setString(3, source_code);
-        //     pstmt->setInt(4, 0);
-        //     pstmt->setString(5, "Pending");
-        //     pstmt->setInt(6, 0);
-        //     pstmt->setInt(7, 0);
-        //     pstmt->setString(8, language);
-        //     pstmt->execute();
-        //     // get the submission ID
-        //     query = "SELECT LAST_INSERT_ID() AS id;";
-        //     std::unique_ptr<sql::PreparedStatement> pstmt2(submissionAPI->prepareStatement(query));
-        //     std::unique_ptr<sql::ResultSet> res(pstmt2->executeQuery());
-        //     res->next();
-        //     submission_id = res->getInt("id");
-        //     submissionAPI->commitTransaction();
-        // } catch (const std::exception& e) {
-        //     submissionAPI->rollbackTransaction();
-        //     return crow::response(500, JSON_ERROR(e.what()));
-        // }
-        // // fetch the test cases
-        // nlohmann::json test_cases;
-        // try {
-        //     std::string query = "SELECT id, input, output, time_limit, memory_limit"
-        //                         "FROM problem_test_cases"
-        //                         "WHERE problem_id = ?;";
-        //     std::unique_ptr<sql::PreparedStatement> pstmt(sqlAPI->prepareStatement(query));
-        //     pstmt->setInt(1, problem_id);
-        //     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-        //     while (res->next()) {
-        //         int test_case_id = res->getInt("id");
-        //         std::string input = res->getString("input");
-        //         std::string output = res->getString("output");
-        //         int time_limit = res->getInt("time_limit");
-        //         int memory_limit = res->getInt("memory_limit");
-        //         nlohmann::json test_case = {
-        //             {"id", test_case_id},
-        //             {"in", input},
-        //             {"ou", output},
-        //             {"ti", time_limit},
-        //             {"me", memory_limit}
-        //         };
-        //         test_cases.push_back(test_case);
-        //     }
-        // } catch (const std::exception& e) {
-        //     return crow::response(500, JSON_ERROR(e.what()));
-        // }
-        // // Send the submission to the sandbox
-        // nlohmann::json payload = {
-        //     {"source_code", source_code},
-        //     {"language", language},
-        //     {"test_cases", test_cases}
-        // };
-        // std::string response = sandboxAPI->POST(payload);
-        // // expect : json object with each test case id and status, time_taken, memory_taken
-        // nlohmann::json result = nlohmann::json::parse(response);
-        // // Save to the database
-        // //update the submission status
-        // try {
-        //     std::string query = "UPDATE problem_submissions SET status = ?, score = ?, time_taken = ?, memory_taken = ? WHERE id = ?;";
-        //     submissionAPI->beginTransaction();
-        //     std::unique_ptr<sql::PreparedStatement> pstmt(submissionAPI->prepareStatement(query));
-        //     pstmt->setString(1, result["status"].get<std::string>());
-        //     pstmt->setInt(2, result["score"].get<int>());
-        //     pstmt->setInt(3, result["time_taken"].get<int>());
-        //     pstmt->setInt(4, result["memory_taken"].get<int>());
-        //     pstmt->setInt(5, submission_id);
-        //     pstmt->execute();
-        //     submissionAPI->commitTransaction();
-        // } catch (const std::exception& e) {
-        //     submissionAPI->rollbackTransaction();
-        //     // set the submission status to Rejected
-        //     try {
-        //         std::string query = "UPDATE problem_submissions SET status = 'Rejected' WHERE id = ?;";
-        //         std::unique_ptr<sql::PreparedStatement> pstmt(submissionAPI->prepareStatement(query));
-        //         pstmt->setInt(1, submission_id);
-        //         pstmt->execute();
-        //     } catch (const std::exception& e) {
-        //         return crow::response(500, JSON_ERROR(e.what()));
-        //     }
-        //     return crow::response(500, JSON_ERROR(e.what()));
-        // }
-        // // upload the subtasks
-        // try {
-        //     std::string query = "INSERT INTO problem_submissions_subtasks (submission_id, test_case_id, status, time_taken, memory_taken) VALUES (?, ?, ?, ?, ?);";
-        //     submissionAPI->beginTransaction();
-        //     std::unique_ptr<sql::PreparedStatement> pstmt(submissionAPI->prepareStatement(query));
-        //     for (const auto& subtask : result["subtasks"]) {
-        //         pstmt->setInt(1, submission_id);
-        //         pstmt->setInt(2, subtask["id"].get<int>());
-        //         pstmt->setString(3, subtask["status"].get<std::string>());
-        //         pstmt->setInt(4, subtask["time_taken"].get<int>());
-        //         pstmt->setInt(5, subtask["memory_taken"].get<int>());
-        //         pstmt->execute();
-        //     }
-        //     submissionAPI->commitTransaction();
-        // } catch (const std::exception& e) {
-        //     submissionAPI->rollbackTransaction();
-        //     return crow::response(500, JSON_ERROR(e.what()));
-        // }
-        // return crow::response(200, result.dump());
+        // Validate the request body
+        nlohmann::json body;
+        try {
+            body = nlohmann::json::parse(req.body);
+        } catch (const std::exception& e) {
+            return crow::response(400, JSON_ERROR("Invalid JSON"));
+        }
+        if (!body.contains("source_code") || !body.contains("language") || !body.contains("problem_id")) {
+            return crow::response(400, JSON_ERROR("Missing required fields"));
+        }
+        // Get the source code, language, and problem ID
+        std::string source_code = body["source_code"].get<std::string>();
+        std::string language = body["language"].get<std::string>();
+        int problem_id = body["problem_id"].get<int>();
+        if(!permission_index.allows(auth, problem_id, settings["permission_flags"]["problems"]["submit"].get<int>())){
+            return crow::response(403, JSON_ERROR("Permission denied"));
+        }
+        // Validate the language
+        if (std::find(accepted_languages.begin(), accepted_languages.end(), language) == accepted_languages.end()) {
+            return crow::response(400, JSON_ERROR("Invalid language"));
+        }
 
-        // testing connection /w sandbox
-        std::string response = sandboxAPI->POST("hi");
-        CROW_LOG_INFO << response;
-        return crow::response(200, response);
+        // byte-identical code judged against the same test cases gets the same verdict
+        std::optional<nlohmann::json> cached = judgeQueue->cachedVerdict(problem_id, language, source_code);
+
+        // insert the submission and mark it as pending, or store the cached verdict right away
+        int64_t submission_id;
+        try {
+            // LAST_INSERT_ID() is per connection, so both statements run in one transaction
+            sqlAPI->beginTransaction();
+            std::string query = "INSERT INTO problem_submissions (problem_id, user_id, submission_time, code, score, status, time_taken, memory_taken, language) VALUES (?, ?, NOW(), ?, ?, ?, ?, ?, ?);";
+            std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement(query));
+            pstmt->setInt(1, problem_id);
+            pstmt->setInt(2, auth.user_id);
+            pstmt->setString(3, source_code);
+            pstmt->setInt(4, cached ? (*cached)["score"].get<int>() : 0);
+            pstmt->setString(5, cached ? (*cached)["status"].get<std::string>() : "Pending");
+            pstmt->setInt(6, cached ? (*cached)["time_taken"].get<int>() : 0);
+            pstmt->setInt(7, cached ? (*cached)["memory_taken"].get<int>() : 0);
+            pstmt->setString(8, language);
+            pstmt->execute();
+            // get the submission ID
+            query = "SELECT LAST_INSERT_ID() AS id;";
+            pstmt = sqlAPI->prepareStatement(query);
+            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
+            res->next();
+            submission_id = res->getInt64("id");
+            res.reset();
+            pstmt.reset();
+            if (cached) {
+                std::vector<std::vector<APIs::BatchValue>> subtasks;
+                for (const auto& subtask : (*cached)["subtasks"]) {
+                    subtasks.push_back({
+                        submission_id,
+                        int64_t(subtask["id"].get<int>()),
+                        subtask["status"].get<std::string>(),
+                        int64_t(subtask["time_taken"].get<int>()),
+                        int64_t(subtask["memory_taken"].get<int>())
+                    });
+                }
+                sqlAPI->insertBatch("problem_submissions_subtasks", {"submission_id", "test_case_id", "status", "time_taken", "memory_taken"}, subtasks);
+            }
+            sqlAPI->commitTransaction();
+        } catch (const std::exception& e) {
+            sqlAPI->rollbackTransaction();
+            return crow::response(500, JSON_ERROR(e.what()));
+        }
+
+        if (cached) {
+            nlohmann::json res;
+            res["submission_id"] = submission_id;
+            res["status"] = (*cached)["status"];
+            res["score"] = (*cached)["score"];
+            res["time_taken"] = (*cached)["time_taken"];
+            res["memory_taken"] = (*cached)["memory_taken"];
+            res["cached"] = true;
+            return crow::response(200, res.dump());
+        }
+
+        // submitters holding one of the contest roles are judged ahead of practice submissions
+        JudgeQueue::Priority priority = JudgeQueue::Priority::Practice;
+        nlohmann::json contestRoles = settings.value("Judge", nlohmann::json::object()).value("contest_roles", nlohmann::json::array());
+        for (uint32_t role : auth.roles) {
+            if (std::find(contestRoles.begin(), contestRoles.end(), RoleNames::name(role)) != contestRoles.end()) {
+                priority = JudgeQueue::Priority::Contest;
+                break;
+            }
+        }
+
+        // hand the submission to the judge workers; the verdict is written back to the row
+        if (!judgeQueue->enqueue({submission_id, problem_id, language, source_code, auth.user_id, priority})) {
+            try {
+                std::unique_ptr<PooledStatement> pstmt(sqlAPI->prepareStatement("UPDATE problem_submissions SET status = 'Rejected' WHERE id = ?;"));
+                pstmt->setInt64(1, submission_id);
+                pstmt->execute();
+            } catch (const std::exception& e) {
+                CROW_LOG_ERROR << "Could not reject submission " << submission_id << ": " << e.what();
+            }
+            return crow::response(503, JSON_ERROR("Judge queue is full, try again later"));
+        }
+        nlohmann::json res;
+        res["submission_id"] = submission_id;
+        res["status"] = "Pending";
+        if (std::optional<size_t> position = judgeQueue->position(submission_id)) {
+            res["position"] = *position;
+        }
+        return crow::response(202, res.dump());
+    });
+
+    CROW_ROUTE(app, "/submit/<int>/position")
+    .methods("GET"_method)
+    ([&app, &judgeQueue](const crow::request& req, int submission_id){
+        QueryStats::Route route("/submit/<int>/position");
+        const AuthContext& auth = authOf(app, req);
+        if (!auth.authenticated) {
+            return crow::response(401, JSON_ERROR(auth.error.empty() ? "Missing token" : auth.error));
+        }
+        // only the submitter and site admins may look at a queued submission
+        std::optional<int> owner = judgeQueue->owner(submission_id);
+        if (owner && *owner != auth.user_id && !auth.isSiteAdmin()) {
+            return crow::response(403, JSON_ERROR("Permission denied"));
+        }
+        std::optional<size_t> position = owner ? judgeQueue->position(submission_id) : std::nullopt;
+        if (!position) {
+            return crow::response(404, JSON_ERROR("Submission is not queued"));
+        }
+        nlohmann::json res;
+        res["submission_id"] = submission_id;
+        res["position"] = *position;
+        return crow::response(200, res.dump());
     });
-}
\ No newline at end of file
+}
@@ -2,8 +2,28 @@
 #include <crow.h>
 #include <crow/middlewares/cors.h>
 #include <nlohmann/json.hpp>
+#include "auth_middleware.hpp"
 #include "../API/api.hpp"
-#include "../API/sand_box_api.hpp"
+#include "../API/judge_queue.hpp"
+#include "../API/permission_index.hpp"
 #include "../Programs/jwt.hpp"
 
-void ROUTE_Submit(crow::App<crow::CORSHandler>& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::unique_ptr<APIs>& submissionAPI, std::vector<std::string> accepted_languages, std::unique_ptr<sand_box_api>& sandboxAPI);
\ No newline at end of file
+/**
+ * @brief Configures the "/submit" route.
+ *
+ * Stores the submission as Pending, queues it on the judge queue and answers 202 with the
+ * submission id and its place in the judge queue right away; the verdict is written to the
+ * submission row by a judge worker. Answers 503 if the judge queue is full. Submitters holding one
+ * of the roles in settings["Judge"]["contest_roles"] are queued in the contest class.
+ * If byte-identical code in the same language was already judged against the problem's current
+ * test cases, the submission is stored with that verdict and its test case results instead, and
+ * the route answers 200 with the verdict and "cached": true.
+ *
+ * Also configures "/submit/<id>/position", which returns the current place of a queued submission
+ * for its submitter so the front end can show "you are #N in queue", or 404 once it left the queue.
+ *
+ * @param accepted_languages The languages of problem_submissions.language, filled at startup after the routes are set up.
+ * @param judgeQueue The queue the submissions are judged from.
+ * @param permission_index Answers whether the submitter may submit to the problem.
+ */
+void ROUTE_Submit(CrowApp& app, nlohmann::json& settings , std::string IP, std::unique_ptr<APIs>& sqlAPI, std::vector<std::string>& accepted_languages, std::unique_ptr<JudgeQueue>& judgeQueue, PermissionIndex& permission_index);
@@ -0,0 +1,41 @@
+/**
+ * @file auth_context.cpp
+ * @brief Implementation of RoleNames and AuthContext.
+ */
+#include "auth_context.hpp"
+
+#include <mutex>
+
+std::shared_mutex RoleNames::mtx;
+std::unordered_map<std::string, uint32_t> RoleNames::ids;
+std::deque<std::string> RoleNames::names;
+
+uint32_t RoleNames::intern(const std::string& name) {
+    {
+        std::shared_lock<std::shared_mutex> lock(mtx);
+        auto it = ids.find(name);
+        if (it != ids.end()) {
+            return it->second;
+        }
+    }
+    std::unique_lock<std::shared_mutex> lock(mtx);
+    auto [it, inserted] = ids.emplace(name, static_cast<uint32_t>(names.size()));
+    if (inserted) {
+        names.push_back(name);
+    }
+    return it->second;
+}
+
+const std::string& RoleNames::name(uint32_t id) {
+    std::shared_lock<std::shared_mutex> lock(mtx);
+    return names.at(id);
+}
+
+std::vector<std::string> AuthContext::roleNames() const {
+    std::vector<std::string> result;
+    result.reserve(roles.size());
+    for (uint32_t role : roles) {
+        result.push_back(RoleNames::name(role));
+    }
+    return result;
+}
@@ -0,0 +1,61 @@
+/**
+ * @file auth_context.hpp
+ * @brief The verified claims of a request's JWT and the interned role names they refer to.
+ */
+#pragma once
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <shared_mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class RoleNames
+ * @brief Interns role names so they can be compared and stored as small integers.
+ *
+ * Ids are handed out in first-seen order and never reused; the set of roles is small and only
+ * grows, so nothing is ever removed.
+ */
+class RoleNames {
+public:
+    /**
+     * @brief Returns the id of a role name, assigning one on first use.
+     */
+    static uint32_t intern(const std::string& name);
+
+    /**
+     * @brief Returns the name of an interned role. The reference stays valid for the whole run.
+     */
+    static const std::string& name(uint32_t id);
+
+private:
+    static std::shared_mutex mtx; /**< Guards ids and names. */
+    static std::unordered_map<std::string, uint32_t> ids; /**< Id of each interned name. */
+    static std::deque<std::string> names; /**< Name of each id; a deque so references stay valid. */
+};
+
+/**
+ * @struct AuthContext
+ * @brief Who sent a request, decoded once from its JWT.
+ */
+struct AuthContext {
+    bool authenticated = false; /**< Whether the request carried a valid JWT; nothing below is set otherwise. */
+    std::string error; /**< Why the JWT was rejected, if it was sent. */
+    int user_id = 0;
+    std::vector<uint32_t> roles; /**< Interned role ids, "everyone" included. */
+    int16_t site_permission_flags = 0;
+    std::chrono::system_clock::time_point expires_at;
+
+    /**
+     * @brief Whether the user holds the site-wide admin flag.
+     */
+    bool isSiteAdmin() const { return site_permission_flags & 1; }
+
+    /**
+     * @brief Returns the role names, e.g. to bind them to a query.
+     */
+    std::vector<std::string> roleNames() const;
+};
@@ -0,0 +1,33 @@
+/**
+ * @file cursor.cpp
+ * @brief Implementation of the keyset pagination cursors.
+ */
+#include "cursor.hpp"
+
+#include <crow.h>
+
+namespace {
+const std::string prefix = "id:";
+}
+
+std::string Cursor::encode(int64_t id) {
+    std::string plain = prefix + std::to_string(id);
+    return crow::utility::base64encode_urlsafe(plain, plain.size());
+}
+
+std::optional<int64_t> Cursor::decode(const std::string& token) {
+    try {
+        std::string plain = crow::utility::base64decode(token, token.size());
+        if (plain.compare(0, prefix.size(), prefix) != 0) {
+            return std::nullopt;
+        }
+        size_t parsed = 0;
+        int64_t id = std::stoll(plain.substr(prefix.size()), &parsed);
+        if (parsed != plain.size() - prefix.size() || id < 0) {
+            return std::nullopt;
+        }
+        return id;
+    } catch (const std::exception& e) {
+        return std::nullopt;
+    }
+}
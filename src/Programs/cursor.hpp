@@ -0,0 +1,27 @@
+/**
+ * @file cursor.hpp
+ * @brief Opaque cursors for keyset pagination.
+ */
+#pragma once
+
+#include <cstdint>
+#include <optional>
+#include <string>
+
+namespace Cursor {
+/**
+ * Encodes the sort key of the last row of a page into an opaque, URL-safe token.
+ *
+ * @param id The id of the last row returned.
+ * @return The token to pass back as the `after` query parameter.
+ */
+std::string encode(int64_t id);
+
+/**
+ * Decodes a token produced by encode().
+ *
+ * @param token The token from the `after` query parameter.
+ * @return The id of the last row of the previous page, or std::nullopt if the token is malformed.
+ */
+std::optional<int64_t> decode(const std::string& token);
+}// namespace Cursor
@@ -0,0 +1,58 @@
+/**
+ * @file gzip.cpp
+ * @brief Implementation of the gzip compression functions.
+ */
+#include "gzip.hpp"
+
+#include <zlib.h>
+#include <stdexcept>
+
+namespace {
+// windowBits 15 plus 16 selects the gzip header instead of the zlib one
+constexpr int gzip_window_bits = 15 + 16;
+constexpr size_t chunk_size = 64 * 1024;
+}
+
+std::string gzipCompress(const std::string& data) {
+    z_stream stream{};
+    if (deflateInit2(&stream, Z_DEFAULT_COMPRESSION, Z_DEFLATED, gzip_window_bits, 8, Z_DEFAULT_STRATEGY) != Z_OK) {
+        throw std::runtime_error("deflateInit2 failed");
+    }
+    std::string compressed;
+    compressed.resize(deflateBound(&stream, data.size()));
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    stream.next_out = reinterpret_cast<Bytef*>(&compressed[0]);
+    stream.avail_out = static_cast<uInt>(compressed.size());
+    int result = deflate(&stream, Z_FINISH);
+    deflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error("deflate failed");
+    }
+    compressed.resize(stream.total_out);
+    return compressed;
+}
+
+std::string gzipDecompress(const std::string& data) {
+    z_stream stream{};
+    if (inflateInit2(&stream, gzip_window_bits) != Z_OK) {
+        throw std::runtime_error("inflateInit2 failed");
+    }
+    stream.next_in = reinterpret_cast<Bytef*>(const_cast<char*>(data.data()));
+    stream.avail_in = static_cast<uInt>(data.size());
+    std::string decompressed;
+    int result = Z_OK;
+    while (result == Z_OK) {
+        size_t offset = decompressed.size();
+        decompressed.resize(offset + chunk_size);
+        stream.next_out = reinterpret_cast<Bytef*>(&decompressed[offset]);
+        stream.avail_out = static_cast<uInt>(chunk_size);
+        result = inflate(&stream, Z_NO_FLUSH);
+        decompressed.resize(offset + chunk_size - stream.avail_out);
+    }
+    inflateEnd(&stream);
+    if (result != Z_STREAM_END) {
+        throw std::runtime_error("Invalid gzip stream");
+    }
+    return decompressed;
+}
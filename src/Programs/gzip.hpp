@@ -0,0 +1,25 @@
+/**
+ * @file gzip.hpp
+ * @brief Header file for the gzip compression functions.
+ */
+#pragma once
+
+#include <string>
+
+/**
+ * Compresses a string into the gzip format, as sent with "Content-Encoding: gzip".
+ *
+ * @param data The bytes to compress.
+ * @return The gzip stream.
+ * @throws std::runtime_error if zlib fails.
+ */
+std::string gzipCompress(const std::string& data);
+
+/**
+ * Decompresses a gzip stream.
+ *
+ * @param data The gzip stream.
+ * @return The original bytes.
+ * @throws std::runtime_error if the stream is not valid gzip.
+ */
+std::string gzipDecompress(const std::string& data);
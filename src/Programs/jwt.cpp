@@ -7,58 +7,32 @@
 #include <crow.h>
 
 
-void JWT::verifyJWT(std::string jwt, nlohmann::json& settings, std::string BE_IP) {
+AuthContext JWT::decodeAuth(const std::string& jwt, nlohmann::json& settings, const std::string& BE_IP) {
     auto decoded = jwt::decode(jwt);
     auto verifier = jwt::verify()
         .allow_algorithm(jwt::algorithm::hs256{settings["jwt_secret"].get<std::string>()})
         .with_issuer(BE_IP)
         .with_audience(BE_IP);
     verifier.verify(decoded);
-    return;
-}
-
-nlohmann::json JWT::getRoles(std::string jwt) {
-    auto decoded = jwt::decode(jwt);
-    return nlohmann::json::parse(decoded.get_payload_claim("roles").as_string());
-}
-
-int16_t JWT::getSitePermissionFlags(const std::string& jwt) {
-    try {
-        auto decoded = jwt::decode(jwt);
-        if (!decoded.has_payload_claim("site_permission_flags")) {
-            throw std::runtime_error("Claim 'site_permission_flags' not found");
-        }
-
-        try {
-            return static_cast<int16_t>(std::stoi(decoded.get_payload_claim("site_permission_flags").as_string()));
-        } catch (const std::bad_cast& e) {
-            throw std::runtime_error("Claim 'site_permission_flags' is not an integer");
-        }
-    } catch (const std::exception& e) {
-        throw std::runtime_error(std::string("Failed to decode JWT: ") + e.what());
-    }
-}
 
-int16_t JWT::getUserID(const std::string& jwt) {
+    AuthContext auth;
     try {
-        auto decoded = jwt::decode(jwt);
-        auto subject = decoded.get_subject();
-        auto json = nlohmann::json::parse(subject);
-        
-        if (!json.is_number_integer()) {
-            throw std::runtime_error("Subject is not an integer");
+        auth.user_id = std::stoi(decoded.get_subject());
+        auth.site_permission_flags = static_cast<int16_t>(std::stoi(decoded.get_payload_claim("site_permission_flags").as_string()));
+        for (const auto& role : nlohmann::json::parse(decoded.get_payload_claim("roles").as_string())) {
+            auth.roles.push_back(RoleNames::intern(role.get<std::string>()));
         }
-        
-        return static_cast<int16_t>(json.get<int>());
+        auth.expires_at = decoded.get_expires_at();
     } catch (const std::exception& e) {
-        // Handle the error appropriately, e.g., log it or rethrow
-        throw std::runtime_error(std::string("Failed to decode JWT or parse subject: ") + e.what());
+        throw std::runtime_error(std::string("Malformed JWT claims: ") + e.what());
     }
+    auth.authenticated = true;
+    return auth;
 }
 
 std::string JWT::generateJWT(nlohmann::json& settings, std::string BE_IP, int user_id, std::unique_ptr<APIs>& sqlapi) {
     std::string query = "SELECT role_name FROM user_roles WHERE user_id = ?";
-    std::unique_ptr<sql::PreparedStatement> pstmt = sqlapi->prepareStatement(query);
+    std::unique_ptr<PooledStatement> pstmt = sqlapi->prepareStatement(query);
     pstmt->setInt(1, user_id);
     std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
     nlohmann::json roles;
@@ -89,44 +63,3 @@ std::string JWT::generateJWT(nlohmann::json& settings, std::string BE_IP, int us
         .sign(jwt::algorithm::hs256{settings["jwt_secret"].get<std::string>()});
     return token;
 }
-
-//return false if the user is not a site admin and dont got the permission
-bool JWT::isPermissioned(std::string jwt, int problem_id, std::unique_ptr<APIs>& API, int permission_flag) {
-    try {
-        // Check if the user has site-wide permission
-        if (!(JWT::getSitePermissionFlags(jwt) & 1)) {
-            nlohmann::json roles = JWT::getRoles(jwt);
-            if (roles.empty()) {
-                return false;
-            }
-
-            std::string query = "SELECT * FROM problem_role WHERE problem_id = ? AND role_name IN (";
-            for (size_t i = 0; i < roles.size(); ++i) {
-                query += "?";
-                if (i < roles.size() - 1) query += ", ";
-            }
-            query += ") AND (permission_flags & ?) <> 0";
-
-            // Prepare the statement
-            std::unique_ptr<sql::PreparedStatement> pstmt(API->prepareStatement(query));
-            pstmt->setInt(1, problem_id);
-            for (size_t i = 0; i < roles.size(); ++i) {
-                pstmt->setString(i + 2, roles[i].get<std::string>());
-            }
-            pstmt->setInt(roles.size() + 2, 1 << permission_flag); // Shift 1 by permission_flag bits
-
-            // Execute the query
-            std::unique_ptr<sql::ResultSet> res(pstmt->executeQuery());
-            if (!res->next()) {
-                return false;
-            }
-        }
-    } catch (const sql::SQLException& e) {
-        std::cerr << "SQL error: " << e.what() << std::endl;
-        return false;
-    } catch (const std::exception& e) {
-        std::cerr << "Error: " << e.what() << std::endl;
-        return false;
-    }
-    return true;
-}
\ No newline at end of file
@@ -8,30 +8,20 @@
 #include <nlohmann/json.hpp>
 #include <jwt-cpp/jwt.h>
 #include "../API/api.hpp"
+#include "auth_context.hpp"
 
 namespace JWT{
 /**
- * Verifies the authenticity of a JSON Web Token (JWT) using the provided settings and backend IP address.
- * 
+ * Verifies a JSON Web Token (JWT) and decodes its claims in one pass.
+ *
  * @param jwt The JWT to be verified.
  * @param settings The JSON object containing the settings for JWT verification.
  * @param BE_IP The IP address of the backend server.
- * 
- * @throws std::runtime_error if the JWT verification fails.
- */
-void verifyJWT(std::string jwt, nlohmann::json& settings, std::string BE_IP);
-
-int16_t getSitePermissionFlags(const std::string& jwt);
-
-int16_t getUserID(const std::string& jwt);
-
-/**
- * Retrieves the roles from a JSON Web Token (JWT).
+ * @return The claims of the token, with the role names interned.
  *
- * @param jwt The JSON Web Token.
- * @return A JSON object containing the roles extracted from the JWT.
+ * @throws std::runtime_error if the JWT verification fails or a claim is malformed.
  */
-nlohmann::json getRoles(std::string jwt);
+AuthContext decodeAuth(const std::string& jwt, nlohmann::json& settings, const std::string& BE_IP);
 
 /**
  * Generates a JSON Web Token (JWT) for the given user.
@@ -44,5 +34,4 @@ nlohmann::json getRoles(std::string jwt);
  */
 std::string generateJWT(nlohmann::json& settings, std::string IP, int user_id, std::unique_ptr<APIs>& sqlAPI);
 
-bool isPermissioned(std::string jwt, int problem_id, std::unique_ptr<APIs>& API, int permission_flag);
 }// namespace JWT
\ No newline at end of file
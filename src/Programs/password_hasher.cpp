@@ -0,0 +1,59 @@
+/**
+ * @file password_hasher.cpp
+ * @brief Implementation of the PasswordHasher class.
+ */
+#include "password_hasher.hpp"
+
+#include <bcrypt/BCrypt.hpp>
+#include <iostream>
+
+namespace {
+uint64_t elapsedUs(std::chrono::steady_clock::time_point start) {
+    return std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start).count();
+}
+}
+
+PasswordHasher::PasswordHasher(const Config& config)
+    : config(config), pool(config.threads, config.max_queue) {}
+
+bool PasswordHasher::run(std::function<void()> job) {
+    return pool.post([this, job = std::move(job), queuedAt = std::chrono::steady_clock::now()] {
+        uint64_t wait = elapsedUs(queuedAt);
+        wait_us_total += wait;
+        uint64_t max = wait_us_max.load();
+        while (wait > max && !wait_us_max.compare_exchange_weak(max, wait)) {
+        }
+        auto start = std::chrono::steady_clock::now();
+        job();
+        hash_us_total += elapsedUs(start);
+        completed++;
+    });
+}
+
+bool PasswordHasher::hash(std::string password, std::function<void(const std::string& hash)> done) {
+    return run([this, password = std::move(password), done = std::move(done)] {
+        std::string hash;
+        try {
+            hash = BCrypt::generateHash(password, config.cost);
+        } catch (const std::exception& e) {
+            std::cerr << "Hashing a password failed: " << e.what() << std::endl;
+        }
+        done(hash);
+    });
+}
+
+bool PasswordHasher::verify(std::string password, std::string hash, std::function<void(bool ok)> done) {
+    return run([password = std::move(password), hash = std::move(hash), done = std::move(done)] {
+        bool ok = false;
+        try {
+            ok = BCrypt::validatePassword(password, hash);
+        } catch (const std::exception& e) {
+            std::cerr << "Checking a password failed: " << e.what() << std::endl;
+        }
+        done(ok);
+    });
+}
+
+PasswordHasher::Stats PasswordHasher::stats() const {
+    return {pool.threadCount(), pool.queueDepth(), completed.load(), pool.rejectedCount(), wait_us_total.load(), wait_us_max.load(), hash_us_total.load(), config.cost};
+}
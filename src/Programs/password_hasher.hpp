@@ -0,0 +1,87 @@
+/**
+ * @file password_hasher.hpp
+ * @brief Header file for the PasswordHasher class.
+ */
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <functional>
+#include <string>
+
+#include "../API/db_executor.hpp"
+
+/**
+ * @class PasswordHasher
+ * @brief Runs bcrypt on a few dedicated threads so login bursts do not occupy the Crow workers.
+ *
+ * A bcrypt hash or check takes tens of milliseconds of CPU. The jobs wait in a bounded queue for
+ * one of `threads` threads; once `max_queue` are waiting, new ones are refused so the route can
+ * answer 503 instead of every request slowing down. The completion callback runs on the hashing
+ * thread and must hand any further database work to the DBExecutor.
+ */
+class PasswordHasher {
+public:
+    /**
+     * @struct Config
+     * @brief Size of the pool and cost of new hashes.
+     */
+    struct Config {
+        size_t threads = 2; /**< Hashing threads; more than the spare cores only adds waiting. */
+        size_t max_queue = 64; /**< Jobs that may wait for a thread. */
+        int cost = 12; /**< bcrypt work factor of new hashes; existing hashes keep the cost they were made with. */
+    };
+
+    /**
+     * @struct Stats
+     * @brief Load and latency counters of the pool.
+     */
+    struct Stats {
+        size_t threads;
+        size_t queue_depth;
+        uint64_t completed;
+        uint64_t rejected; /**< Jobs refused because the queue was full. */
+        uint64_t wait_us_total; /**< Time jobs spent queued. */
+        uint64_t wait_us_max;
+        uint64_t hash_us_total; /**< Time spent in bcrypt. */
+        int cost;
+    };
+
+    /**
+     * @brief Starts the hashing threads.
+     */
+    explicit PasswordHasher(const Config& config);
+
+    /**
+     * @brief Hashes a password at the configured cost.
+     * @param done Called on a hashing thread with the hash, or with an empty string if bcrypt failed.
+     * @return false if the queue is full; done is not called then.
+     */
+    bool hash(std::string password, std::function<void(const std::string& hash)> done);
+
+    /**
+     * @brief Checks a password against a stored hash.
+     * @param done Called on a hashing thread with whether the password matches.
+     * @return false if the queue is full; done is not called then.
+     */
+    bool verify(std::string password, std::string hash, std::function<void(bool ok)> done);
+
+    /**
+     * @brief Returns the load and latency counters.
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief Queues a job, counting its wait and run time.
+     */
+    bool run(std::function<void()> job);
+
+    Config config; /**< Size of the pool and cost of new hashes. */
+    std::atomic<uint64_t> completed{0}; /**< Jobs run. */
+    std::atomic<uint64_t> wait_us_total{0}; /**< Time jobs spent queued. */
+    std::atomic<uint64_t> wait_us_max{0}; /**< Longest time a job spent queued. */
+    std::atomic<uint64_t> hash_us_total{0}; /**< Time spent in bcrypt. */
+    DBExecutor pool; /**< The bounded thread pool; declared last so it stops before the counters go. */
+};
@@ -0,0 +1,60 @@
+/**
+ * @file problem_counters.cpp
+ * @brief Implementation of the ProblemCounters class.
+ */
+#include "problem_counters.hpp"
+
+#include <algorithm>
+
+int64_t ProblemCounters::get(Scope scope, const std::vector<std::string>& roles, const std::function<int64_t()>& load) {
+    std::string k = key(scope, roles);
+    uint64_t loadGeneration;
+    {
+        std::lock_guard<std::mutex> lock(mtx);
+        auto it = counts.find(k);
+        if (it != counts.end()) {
+            hits++;
+            return it->second;
+        }
+        loadGeneration = generation;
+    }
+    misses++;
+    int64_t count = load();
+    if (count < 0) {
+        return count;
+    }
+    std::lock_guard<std::mutex> lock(mtx);
+    if (generation == loadGeneration) {
+        if (counts.size() >= max_entries) {
+            counts.clear();
+        }
+        counts[k] = count;
+    }
+    return count;
+}
+
+void ProblemCounters::invalidate() {
+    std::lock_guard<std::mutex> lock(mtx);
+    counts.clear();
+    generation++;
+}
+
+ProblemCounters::Stats ProblemCounters::stats() const {
+    std::lock_guard<std::mutex> lock(mtx);
+    return {hits.load(), misses.load(), counts.size()};
+}
+
+std::string ProblemCounters::key(Scope scope, std::vector<std::string> roles) {
+    std::string k(1, static_cast<char>('0' + static_cast<int>(scope)));
+    if (scope == Scope::All) {
+        return k;
+    }
+    std::sort(roles.begin(), roles.end());
+    roles.erase(std::unique(roles.begin(), roles.end()), roles.end());
+    for (const auto& role : roles) {
+        // role names cannot contain the unit separator, so the key is unambiguous
+        k += '\x1f';
+        k += role;
+    }
+    return k;
+}
@@ -0,0 +1,77 @@
+/**
+ * @file problem_counters.hpp
+ * @brief In-process cache of the number of problems each role set can see.
+ */
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+/**
+ * @class ProblemCounters
+ * @brief Caches problem counts keyed by the normalized (sorted, deduplicated) role set.
+ *
+ * The count only changes when problems or problem_role rows change, and those writes all go
+ * through the manage panel, which calls invalidate() after committing. Loaders must read from the
+ * primary, or a lagging replica would be cached until that next write. Listing pages therefore
+ * only run their COUNT once per role set between two such writes.
+ */
+class ProblemCounters {
+public:
+    /**
+     * @brief Which problems are counted.
+     */
+    enum class Scope {
+        View,   /**< Problems listed on /problems for the role set. */
+        Manage, /**< Problems the role set may manage (permission flag 1). */
+        All     /**< Every problem, as seen by site admins; the role set is ignored. */
+    };
+
+    /**
+     * @brief Hit, miss and size counters of the cache.
+     */
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        size_t entries;
+    };
+
+    /**
+     * @brief Returns the cached count of the role set, loading it on a miss.
+     * @param scope Which problems are counted.
+     * @param roles The role names of the user, in any order.
+     * @param load Runs the COUNT query. It is called without the lock held; a negative result is
+     *             treated as an error and is not cached.
+     * @return The count, or the negative result of load.
+     */
+    int64_t get(Scope scope, const std::vector<std::string>& roles, const std::function<int64_t()>& load);
+
+    /**
+     * @brief Drops every cached count. Call it after committing a change to problems or problem_role.
+     */
+    void invalidate();
+
+    /**
+     * @brief Returns the hit, miss and size counters.
+     */
+    Stats stats() const;
+
+private:
+    /**
+     * @brief Builds the cache key of a scope and role set.
+     */
+    static std::string key(Scope scope, std::vector<std::string> roles);
+
+    static constexpr size_t max_entries = 4096; /**< The cache is cleared when it grows past this. */
+
+    mutable std::mutex mtx; /**< Guards counts and generation. */
+    std::unordered_map<std::string, int64_t> counts; /**< Cached counts by key. */
+    uint64_t generation = 0; /**< Bumped by invalidate() so a load racing it is not cached. */
+    std::atomic<uint64_t> hits{0}; /**< Lookups answered from the cache. */
+    std::atomic<uint64_t> misses{0}; /**< Lookups that ran load. */
+};
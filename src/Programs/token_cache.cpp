@@ -0,0 +1,67 @@
+/**
+ * @file token_cache.cpp
+ * @brief Implementation of the TokenCache class.
+ */
+#include "token_cache.hpp"
+#include "hash_SHA256.hpp"
+
+#include <algorithm>
+#include <functional>
+
+TokenCache::TokenCache(size_t max_entries)
+    : max_entries(std::max<size_t>(max_entries, 1)),
+      shard_entries((this->max_entries + shard_count - 1) / shard_count) {
+    for (Shard& shard : shards) {
+        shard.tokens = std::make_unique<cache::lru_cache<std::string, AuthContext>>(shard_entries);
+    }
+}
+
+TokenCache::Shard& TokenCache::shardOf(const std::string& digest) {
+    return shards[std::hash<std::string>{}(digest) % shard_count];
+}
+
+std::optional<AuthContext> TokenCache::get(const std::string& token) {
+    std::string digest = sha256(token);
+    Shard& shard = shardOf(digest);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    if (!shard.tokens->exists(digest)) {
+        misses++;
+        return std::nullopt;
+    }
+    const AuthContext& auth = shard.tokens->get(digest);
+    // the entry stays until evicted or overwritten, but is never served past exp
+    if (auth.expires_at <= std::chrono::system_clock::now()) {
+        expired++;
+        misses++;
+        return std::nullopt;
+    }
+    hits++;
+    return auth;
+}
+
+void TokenCache::put(const std::string& token, const AuthContext& auth) {
+    if (!auth.authenticated || auth.expires_at <= std::chrono::system_clock::now()) {
+        return;
+    }
+    std::string digest = sha256(token);
+    Shard& shard = shardOf(digest);
+    std::lock_guard<std::mutex> lock(shard.mtx);
+    shard.tokens->put(digest, auth);
+}
+
+void TokenCache::flush() {
+    for (Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        shard.tokens = std::make_unique<cache::lru_cache<std::string, AuthContext>>(shard_entries);
+    }
+    flushes++;
+}
+
+TokenCache::Stats TokenCache::stats() const {
+    size_t entries = 0;
+    for (const Shard& shard : shards) {
+        std::lock_guard<std::mutex> lock(shard.mtx);
+        entries += shard.tokens->size();
+    }
+    return {hits.load(), misses.load(), expired.load(), flushes.load(), entries, max_entries};
+}
@@ -0,0 +1,94 @@
+/**
+ * @file token_cache.hpp
+ * @brief In-process cache of verified JWTs and their decoded claims.
+ */
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <optional>
+#include <string>
+
+#include "auth_context.hpp"
+#include "../include/lrucache.hpp"
+
+/**
+ * @class TokenCache
+ * @brief Remembers the claims of tokens that passed verification until they expire.
+ *
+ * The front end sends the same token with every request for its whole lifetime, so after the
+ * first request verifying and decoding it is a hash lookup. Entries are keyed by the SHA-256 of
+ * the token, so the tokens themselves are not kept, and are not returned past the token's exp.
+ * The cache is split into shards with a lock each, so concurrent requests rarely wait on each
+ * other. Only verified tokens are cached; a token signed with a rotated-out secret stays valid
+ * until flush() is called.
+ */
+class TokenCache {
+public:
+    /**
+     * @brief Hit, miss and size counters of the cache.
+     */
+    struct Stats {
+        uint64_t hits;
+        uint64_t misses;
+        uint64_t expired; /**< Lookups that found an entry past its exp, counted in misses too. */
+        uint64_t flushes;
+        size_t entries;
+        size_t max_entries;
+    };
+
+    /**
+     * @param max_entries The most tokens kept over all shards.
+     */
+    explicit TokenCache(size_t max_entries = 65536);
+
+    /**
+     * @brief Returns the cached claims of a token, or std::nullopt if it is unknown or expired.
+     */
+    std::optional<AuthContext> get(const std::string& token);
+
+    /**
+     * @brief Caches the claims of a verified token until its expiry. Unauthenticated or already
+     * expired claims are ignored.
+     */
+    void put(const std::string& token, const AuthContext& auth);
+
+    /**
+     * @brief Drops every entry. Call it after rotating jwt_secret so tokens signed with the old
+     * secret are verified again.
+     */
+    void flush();
+
+    /**
+     * @brief Returns the hit, miss and size counters.
+     */
+    Stats stats() const;
+
+private:
+    static constexpr size_t shard_count = 16;
+
+    /**
+     * @struct Shard
+     * @brief A part of the tokens, picked by their digest.
+     */
+    struct Shard {
+        mutable std::mutex mtx; /**< Held around every use of tokens, since get() returns a reference. */
+        std::unique_ptr<cache::lru_cache<std::string, AuthContext>> tokens; /**< Claims by token digest. */
+    };
+
+    /**
+     * @brief Returns the shard of a token digest.
+     */
+    Shard& shardOf(const std::string& digest);
+
+    size_t max_entries; /**< The most tokens kept over all shards. */
+    size_t shard_entries; /**< The most tokens kept per shard. */
+    std::array<Shard, shard_count> shards;
+    std::atomic<uint64_t> hits{0}; /**< Lookups answered from the cache. */
+    std::atomic<uint64_t> misses{0}; /**< Lookups that found nothing usable. */
+    std::atomic<uint64_t> expired{0}; /**< Lookups that found an expired entry. */
+    std::atomic<uint64_t> flushes{0}; /**< Calls to flush(). */
+};
@@ -36,8 +36,10 @@
 #include <unordered_map>
 #include <list>
 #include <cstddef>
+#include <cstdint>
 #include <stdexcept>
 #include <mutex>
+#include <optional>
 
 namespace cache {
 
@@ -53,20 +55,7 @@ public:
 	
 	void put(const key_t& key, const value_t& value) {
 		std::lock_guard<std::mutex> lock(_mutex);
-		auto it = _cache_items_map.find(key);
-		_cache_items_list.push_front(key_value_pair_t(key, value));
-		if (it != _cache_items_map.end()) {
-			_cache_items_list.erase(it->second);
-			_cache_items_map.erase(it);
-		}
-		_cache_items_map[key] = _cache_items_list.begin();
-		
-		if (_cache_items_map.size() > _max_size) {
-			auto last = _cache_items_list.end();
-			last--;
-			_cache_items_map.erase(last->first);
-			_cache_items_list.pop_back();
-		}
+		_put(key, value);
 	}
 	
 	const value_t& get(const key_t& key) {
@@ -80,6 +69,46 @@ public:
 		}
 	}
 	
+	// copies the value under the lock, so a concurrent put() evicting it cannot invalidate the result
+	std::optional<value_t> try_get(const key_t& key) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _cache_items_map.find(key);
+		if (it == _cache_items_map.end()) {
+			return std::nullopt;
+		}
+		_cache_items_list.splice(_cache_items_list.begin(), _cache_items_list, it->second);
+		return it->second->second;
+	}
+	
+	// moves the key's generation forward, so a value loaded before the erase is not put back
+	void erase(const key_t& key) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		_generations[key] = ++_clock;
+		auto it = _cache_items_map.find(key);
+		if (it != _cache_items_map.end()) {
+			_cache_items_list.erase(it->second);
+			_cache_items_map.erase(it);
+		}
+	}
+	
+	// take it before loading a value, and store the value with put_if_current()
+	uint64_t generation(const key_t& key) const {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _generations.find(key);
+		return it == _generations.end() ? 0 : it->second;
+	}
+	
+	// puts the value unless the key was erased since `generation` was taken
+	bool put_if_current(const key_t& key, const value_t& value, uint64_t generation) {
+		std::lock_guard<std::mutex> lock(_mutex);
+		auto it = _generations.find(key);
+		if ((it == _generations.end() ? 0 : it->second) != generation) {
+			return false;
+		}
+		_put(key, value);
+		return true;
+	}
+	
 	bool exists(const key_t& key) const {
 		std::lock_guard<std::mutex> lock(_mutex);
 		return _cache_items_map.find(key) != _cache_items_map.end();
@@ -91,8 +120,28 @@ public:
 	}
 	
 private:
+	// requires _mutex
+	void _put(const key_t& key, const value_t& value) {
+		auto it = _cache_items_map.find(key);
+		_cache_items_list.push_front(key_value_pair_t(key, value));
+		if (it != _cache_items_map.end()) {
+			_cache_items_list.erase(it->second);
+			_cache_items_map.erase(it);
+		}
+		_cache_items_map[key] = _cache_items_list.begin();
+		
+		if (_cache_items_map.size() > _max_size) {
+			auto last = _cache_items_list.end();
+			last--;
+			_cache_items_map.erase(last->first);
+			_cache_items_list.pop_back();
+		}
+	}
+	
 	std::list<key_value_pair_t> _cache_items_list;
 	std::unordered_map<key_t, list_iterator_t> _cache_items_map;
+	std::unordered_map<key_t, uint64_t> _generations;
+	uint64_t _clock = 0;
 	size_t _max_size;
 	mutable std::mutex _mutex;
 };
@@ -0,0 +1,114 @@
+/**
+ * @file stub_sandbox.cpp
+ * @brief A fake sandbox node for exercising the judge queue and SandboxPool without real judges.
+ *
+ * Answers the "hi" connectivity probe and judges every job with a fixed verdict after a
+ * configurable delay, failing a configurable share of requests with 503. Like a real node it keeps
+ * the test case contents it was sent by hash, answers {"missing": [...]} for the ones it lacks,
+ * accepts gzip-compressed bodies and answers jobs asking to "stream" with one JSON line per test
+ * case followed by the result (all at once, as Crow buffers the response).
+ *
+ * Usage: stub_sandbox [port] [latency_ms] [fail_rate] [verdict]
+ *   port        Port to listen on (default 45803).
+ *   latency_ms  Time spent "judging" each job (default 100).
+ *   fail_rate   Share of requests answered with 503, 0 to 1 (default 0).
+ *   verdict     Status of every test case (default "Accepted").
+ */
+#include <crow.h>
+#include <nlohmann/json.hpp>
+
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <unordered_map>
+
+#include "../src/Programs/gzip.hpp"
+#include "../src/Programs/hash_SHA256.hpp"
+
+int main(int argc, char** argv) {
+    int port = argc > 1 ? std::stoi(argv[1]) : 45803;
+    int latency_ms = argc > 2 ? std::stoi(argv[2]) : 100;
+    double fail_rate = argc > 3 ? std::stod(argv[3]) : 0;
+    std::string verdict = argc > 4 ? argv[4] : "Accepted";
+    std::atomic<uint64_t> judged{0};
+    std::mutex blobs_mtx;
+    std::unordered_map<std::string, std::string> blobs;
+
+    crow::SimpleApp app;
+    CROW_ROUTE(app, "/")
+    .methods("POST"_method)
+    ([&](const crow::request& req) {
+        thread_local std::mt19937 rng(std::random_device{}());
+        if (std::uniform_real_distribution<double>(0, 1)(rng) < fail_rate) {
+            return crow::response(503, "stub failure");
+        }
+        std::string body = req.body;
+        if (req.get_header_value("Content-Encoding") == "gzip") {
+            try {
+                body = gzipDecompress(body);
+            } catch (const std::exception& e) {
+                return crow::response(400, e.what());
+            }
+        }
+        nlohmann::json job = nlohmann::json::parse(body, nullptr, false);
+        if (job.is_discarded() || job == "hi") {
+            return crow::response(200, "hi");
+        }
+        nlohmann::json missing = nlohmann::json::array();
+        {
+            std::lock_guard<std::mutex> lock(blobs_mtx);
+            for (const auto& [hash, content] : job.value("blobs", nlohmann::json::object()).items()) {
+                if (sha256(content.get<std::string>()) != hash) {
+                    return crow::response(400, "blob does not match its hash " + hash);
+                }
+                blobs[hash] = content.get<std::string>();
+            }
+            for (const auto& test_case : job.value("test_cases", nlohmann::json::array())) {
+                for (const char* field : {"in_hash", "ou_hash"}) {
+                    if (test_case.contains(field) && !blobs.count(test_case[field].get<std::string>())) {
+                        missing.push_back(test_case[field]);
+                    }
+                }
+            }
+        }
+        if (!missing.empty()) {
+            return crow::response(200, nlohmann::json({{"missing", missing}}).dump());
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(latency_ms));
+
+        nlohmann::json result;
+        result["subtasks"] = nlohmann::json::array();
+        int time_taken = 0, memory_taken = 0;
+        for (const auto& test_case : job.value("test_cases", nlohmann::json::array())) {
+            int time = std::uniform_int_distribution<int>(0, std::max(0, test_case.value("ti", 1000) / 2))(rng);
+            int memory = std::uniform_int_distribution<int>(0, std::max(0, test_case.value("me", 256) / 2))(rng);
+            result["subtasks"].push_back({
+                {"id", test_case.value("id", 0)},
+                {"status", verdict},
+                {"time_taken", time},
+                {"memory_taken", memory}
+            });
+            time_taken = std::max(time_taken, time);
+            memory_taken = std::max(memory_taken, memory);
+        }
+        result["status"] = verdict;
+        result["score"] = verdict == "Accepted" ? 10000 : 0;
+        result["time_taken"] = time_taken;
+        result["memory_taken"] = memory_taken;
+        CROW_LOG_INFO << "Judged job " << ++judged << " (" << result["subtasks"].size() << " test cases)";
+        if (!job.value("stream", false)) {
+            return crow::response(200, result.dump());
+        }
+        // streamed form: one line per test case, then the whole result
+        std::string lines;
+        for (const auto& subtask : result["subtasks"]) {
+            lines += subtask.dump() + "\n";
+        }
+        return crow::response(200, lines + result.dump() + "\n");
+    });
+
+    app.port(port).multithreaded().run();
+}